@@ -27,6 +27,15 @@ void sti (void)
     asm("MSR cpsr_cxsf, %[v]": :[v]"r" (val):);
 }
 
+// wait for interrupt: stop the core until an interrupt is pending,
+// even a masked one (CP15 c7 operation on the arm1176)
+void wfi (void)
+{
+    uint val = 0;
+
+    asm("MCR p15, 0, %[r], c7, c0, 4": :[r]"r" (val):);
+}
+
 // return the cpsr used for user program
 uint spsr_usr ()
 {
@@ -9,6 +9,8 @@
 // * To get a buffer for a particular disk block, call bread.
 // * After changing buffer data, call bwrite to write it to disk.
 // * When done with the buffer, call brelse.
+// * breadv/bwritev do the same for a run of consecutive sectors,
+//     moving them with as few disk requests as possible.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
@@ -90,7 +92,9 @@ static struct buf* bget (uint dev, uint sector)
         }
     }
 
-    panic("bget: no buffers");
+    // All are busy, or dirty and held for the log; wait for a brelse.
+    sleep(&bcache, &bcache.lock);
+    goto loop;
 }
 
 // Return a B_BUSY buf with the contents of the indicated disk sector.
@@ -118,6 +122,57 @@ void bwrite (struct buf *b)
     iderw(b);
 }
 
+// Return n B_BUSY bufs for the consecutive sectors starting at
+// sector in bv[]. Sectors that are not cached are read with one
+// disk request per run. Bufs are taken in ascending sector order.
+void breadv (uint dev, uint sector, int n, struct buf **bv)
+{
+    int i, j;
+
+    if (n <= 0 || n > NBCLUSTER) {
+        panic("breadv");
+    }
+
+    for (i = 0; i < n; i++) {
+        bv[i] = bget(dev, sector + i);
+    }
+
+    for (i = 0; i < n; i = j) {
+        if (bv[i]->flags & B_VALID) {
+            j = i + 1;
+            continue;
+        }
+
+        for (j = i + 1; j < n && !(bv[j]->flags & B_VALID); j++)
+            ;
+
+        iderwv(bv + i, j - i);
+    }
+}
+
+// Write the contents of n B_BUSY bufs to disk, one request
+// per run of consecutive sectors.
+void bwritev (struct buf **bv, int n)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        if ((bv[i]->flags & B_BUSY) == 0) {
+            panic("bwritev");
+        }
+
+        bv[i]->flags |= B_DIRTY;
+    }
+
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && j - i < NBCLUSTER && bv[j]->dev == bv[i]->dev
+                && bv[j]->sector == bv[i]->sector + (j - i); j++)
+            ;
+
+        iderwv(bv + i, j - i);
+    }
+}
+
 // Release a B_BUSY buffer.
 // Move to the head of the MRU list.
 void brelse (struct buf *b)
@@ -137,6 +192,7 @@ void brelse (struct buf *b)
 
     b->flags &= ~B_BUSY;
     wakeup(b);
+    wakeup(&bcache);
 
     release(&bcache.lock);
 }
@@ -35,12 +35,23 @@ struct order {
     uint32  offset;     // the first mark
 };
 
+// Blocks zeroed ahead of time by the idle loop, for the orders of
+// pages and of page tables. The pool is linked through the first
+// word of each block, which is cleared again when it is handed out.
+struct zpool {
+    void            *head;
+    int             n;
+    int             max;
+};
+
 struct kmem {
     struct spinlock lock;
     uint            start;             // start of memory for marks
     uint            start_heap;        // start of allocatable memory
     uint            end;
     struct order    orders[N_ORD];  // orders used for buddy systems
+    struct zpool    zpools[N_ORD];  // pre-zeroed blocks (max 0: none)
+    uint16          *pgref;         // extra references to each page
 };
 
 static struct kmem kmem;
@@ -69,6 +80,9 @@ static inline int available (uint bitmap, int blk_id)
 void kmem_init (void)
 {
     initlock(&kmem.lock, "kmem");
+
+    kmem.zpools[PTE_SHIFT - MIN_ORD].max = 32;
+    kmem.zpools[PT_ORDER - MIN_ORD].max = 32;
 }
 
 void kmem_init2(void *vstart, void *vend)
@@ -103,8 +117,13 @@ void kmem_init2(void *vstart, void *vend)
         n <<= 1;     // each order doubles required marks
     }
 
+    // one reference count per page follows the marks
+    kmem.pgref = (uint16*)(kmem.start + total * sizeof(*mk));
+    n = (len >> PTE_SHIFT) + 1;
+    memset(kmem.pgref, 0, n * sizeof(uint16));
+
     // add all available memory to the highest order bucket
-    kmem.start_heap = align_up(kmem.start + total * sizeof(*mk), 1 << MAX_ORD);
+    kmem.start_heap = align_up((uint)(kmem.pgref + n), 1 << MAX_ORD);
     
     for (i = kmem.start_heap; i < kmem.end; i += (1 << MAX_ORD)){
         kfree ((void*)i, MAX_ORD);
@@ -241,6 +260,24 @@ static void *_kmalloc (int order)
     return up;
 }
 
+// give the pre-zeroed blocks back to the buddy lists
+static void drain_zpools (void)
+{
+    struct zpool *zp;
+    void **blk;
+    int i;
+
+    for (i = 0; i < N_ORD; i++) {
+        zp = &kmem.zpools[i];
+
+        while ((blk = zp->head) != NULL) {
+            zp->head = *blk;
+            zp->n--;
+            _kfree(blk, i + MIN_ORD);
+        }
+    }
+}
+
 // allocate memory that has the size of (1 << order)
 void *kmalloc (int order)
 {
@@ -251,12 +288,116 @@ void *kmalloc (int order)
     }
 
     acquire(&kmem.lock);
-    up = _kmalloc(order);
+
+    // the zeroed pools are only a cache, use them before failing
+    if ((up = _kmalloc(order)) == NULL) {
+        drain_zpools();
+        up = _kmalloc(order);
+    }
+
     release(&kmem.lock);
 
     return up;
 }
 
+// take a pre-zeroed block of the order, or return NULL if there is none
+void *kmalloc_prezeroed (int order)
+{
+    struct zpool *zp;
+    void **blk;
+
+    zp = &kmem.zpools[order - MIN_ORD];
+
+    acquire(&kmem.lock);
+
+    if ((blk = zp->head) != NULL) {
+        zp->head = *blk;
+        zp->n--;
+        *blk = NULL;
+    }
+
+    release(&kmem.lock);
+
+    return blk;
+}
+
+// allocate zero-filled memory that has the size of (1 << order)
+void *kmalloc_zero (int order)
+{
+    uint8         *up;
+
+    if ((order > MAX_ORD) || (order < MIN_ORD)) {
+        panic("kmalloc_zero: order out of range\n");
+    }
+
+    if ((up = kmalloc_prezeroed(order)) == NULL && (up = kmalloc(order)) != NULL) {
+        memset(up, 0, 1 << order);
+    }
+
+    return up;
+}
+
+// Return the order of a zeroed pool that is not full and can be
+// refilled from free memory, or -1 if there is none.
+static int zpool_to_fill (void)
+{
+    int i, j;
+
+    for (i = N_ORD - 1; i >= 0; i--) {
+        if (kmem.zpools[i].n >= kmem.zpools[i].max) {
+            continue;
+        }
+
+        for (j = i; j < N_ORD; j++) {
+            if (kmem.orders[j].head != NIL) {
+                return i + MIN_ORD;
+            }
+        }
+    }
+
+    return -1;
+}
+
+// Return 1 if the idle loop has blocks to zero. The scheduler asks
+// this with interrupts off before it decides to wait for one.
+int kmem_zero_wanted (void)
+{
+    return zpool_to_fill() >= 0;
+}
+
+// Zero one free block for a pool that is not full. Called by the
+// idle loop with interrupts on; the memset runs without the lock.
+void kmem_zero_idle (void)
+{
+    struct zpool *zp;
+    void **blk;
+    int order;
+
+    acquire(&kmem.lock);
+
+    if ((order = zpool_to_fill()) < 0) {
+        release(&kmem.lock);
+        return;
+    }
+
+    blk = _kmalloc(order);
+    release(&kmem.lock);
+
+    if (blk == NULL) {
+        return;
+    }
+
+    memset(blk, 0, 1 << order);
+
+    zp = &kmem.zpools[order - MIN_ORD];
+
+    acquire(&kmem.lock);
+    *blk = zp->head;
+    zp->head = blk;
+    zp->n++;
+    release(&kmem.lock);
+}
+
 void _kfree (void *mem, int order)
 {
     int blk_id, buddy_id;
@@ -293,10 +434,50 @@ void kfree (void *mem, int order)
     release(&kmem.lock);
 }
 
+// Pages can have more than one owner, e.g., a file page that is in
+// the page cache and mapped as text into some processes. pgref counts
+// the owners beyond the first; free_page drops one owner and frees
+// the page only when it was the last.
+static uint16* page_ref (void *v)
+{
+    if (((uint)v < kmem.start_heap) || ((uint)v >= kmem.end) || ((uint)v & (PTE_SZ - 1))) {
+        panic("page_ref: bad page");
+    }
+
+    return &kmem.pgref[((uint)v - kmem.start_heap) >> PTE_SHIFT];
+}
+
+// add an owner to a page
+void page_dup (void *v)
+{
+    acquire(&kmem.lock);
+    (*page_ref(v))++;
+    release(&kmem.lock);
+}
+
+// return whether a page has more than one owner
+int page_shared (void *v)
+{
+    return *page_ref(v) != 0;
+}
+
 // free a page
 void free_page(void *v)
 {
-    kfree (v, PTE_SHIFT);
+    uint16 *ref;
+
+    ref = page_ref(v);
+
+    acquire(&kmem.lock);
+
+    if (*ref > 0) {
+        (*ref)--;
+        release(&kmem.lock);
+        return;
+    }
+
+    _kfree(v, PTE_SHIFT);
+    release(&kmem.lock);
 }
 
 // allocate a page
@@ -305,6 +486,12 @@ void* alloc_page (void)
     return kmalloc (PTE_SHIFT);
 }
 
+// allocate a zero-filled page
+void* alloc_zpage (void)
+{
+    return kmalloc_zero (PTE_SHIFT);
+}
+
 // round up power of 2, then get the order
 //   http://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
 int get_order (uint32 v)
@@ -15,4 +15,19 @@ struct buf {
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
 
+// block device numbers (buf.dev)
+#define MEMDISK 1    // disk image linked into the kernel
+#define SDDISK  2    // SD card on the PL181 MMC controller
+
+// A block device driver, registered with ideregister. start begins
+// a transfer of n bufs for consecutive sectors, all in the direction
+// given by B_DIRTY. It returns 1 if the transfer has already completed;
+// otherwise the driver calls ideintr(dev) when it is done.
+struct blkdev {
+    char *name;
+    uint nsector;   // size of the device in sectors
+    int  maxrun;    // max bufs per transfer, at most NBCLUSTER
+    int  (*start)(struct buf **bv, int n);
+};
+
 #endif
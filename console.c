@@ -11,6 +11,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "poll.h"
 
 static void consputc (int);
 
@@ -371,6 +372,7 @@ void consoleintr (int (*getc) (void))
                 if (c == '\n' || c == C('D') || input.e == input.r + INPUT_BUF) {
                     input.w = input.e;
                     wakeup(&input.r);
+                    pollwake(&input);
                 }
             }
 
@@ -428,6 +430,27 @@ int consoleread (struct inode *ip, char *dst, int n)
     return target - n;
 }
 
+// Input is ready once a line is; output always is.
+int consolepoll (struct inode *ip, int events)
+{
+    int r;
+
+    acquire(&input.lock);
+
+    r = events & POLLOUT;
+
+    if (input.r != input.w) {
+        r |= events & POLLIN;
+    }
+
+    if (r == 0 && pollenter(&input) < 0) {
+        r = -1;
+    }
+
+    release(&input.lock);
+    return r;
+}
+
 int consolewrite (struct inode *ip, char *buf, int n)
 {
     int i;
@@ -454,6 +477,7 @@ void consoleinit (void)
 
     devsw[CONSOLE].write = consolewrite;
     devsw[CONSOLE].read = consoleread;
+    devsw[CONSOLE].poll = consolepoll;
 
     cons.locking = 1;
 
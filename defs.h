@@ -10,10 +10,13 @@
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
 
+struct blkdev;
 struct buf;
 struct context;
+struct direntplus;
 struct file;
 struct inode;
+struct iovec;
 struct pipe;
 struct proc;
 struct pstat;
@@ -31,6 +34,7 @@ typedef void (*ISR) (struct trapframe *tf, int n);
 void            set_stk(uint mode, uint addr);
 void            cli (void);
 void            sti (void);
+void            wfi (void);
 uint            spsr_usr();
 int             int_enabled();
 void            pushcli(void);
@@ -45,13 +49,22 @@ void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            breadv(uint, uint, int, struct buf**);
+void            bwritev(struct buf**, int);
 
 // buddy.c
 void            kmem_init (void);
 void            kmem_init2(void *vstart, void *vend);
 void*           kmalloc (int order);
+void*           kmalloc_zero (int order);
+void*           kmalloc_prezeroed (int order);
+void*           alloc_zpage (void);
+int             kmem_zero_wanted (void);
+void            kmem_zero_idle (void);
 void            kfree (void *mem, int order);
 void            free_page(void *v);
+void            page_dup(void *v);
+int             page_shared(void *v);
 void*           alloc_page (void);
 void            kmem_test_b (void);
 int             get_order (uint32 v);
@@ -68,6 +81,8 @@ struct TrieNode* trie_find(const char *prefix);
 void            autocomplete(uint *e, char *buf, uint w);
 
 // exec.c
+struct uimage;
+int             exec_load(char*, char**, struct uimage*);
 int             exec(char*, char**);
 
 // file.c
@@ -76,13 +91,20 @@ void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, char*, int n);
+int             filereadv(struct file*, struct iovec*, int, int);
+int             filepoll(struct file*, int);
 int             filestat(struct file*, struct stat*);
+int             filereaddir(struct file*, struct direntplus*, int);
 int             filewrite(struct file*, char*, int n);
+int             filewritev(struct file*, struct iovec*, int, int);
+int             filesplice(struct file*, struct file*, int);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+int             dirhashed(struct inode*);
+int             readdirplus(struct inode*, uint*, struct direntplus*, int);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(void);
@@ -95,12 +117,18 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, char*, uint, uint);
+int             readblocks(struct inode*, char*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
 // ide.c
+extern int      rootdev;
 void            ideinit(void);
+void            ideregister(int, struct blkdev*);
+int             idepresent(int);
+void            ideintr(int);
 void            iderw(struct buf*);
+void            iderwv(struct buf**, int);
 
 // kalloc.c
 /*char*           kalloc(void);
@@ -112,26 +140,74 @@ void            kmem_init (void);*/
 // log.c
 void            initlog(void);
 void            log_write(struct buf*);
+int             log_room(void);
+void            log_undo(struct buf*);
 void            begin_trans();
 void            commit_trans();
 
+// memide.c
+void            memdisk_init(void);
+
+// mmc.c
+int             mmc_init(void*);
+
 // picirq.c
 void            pic_enable(int, ISR);
 void            pic_init(void*);
 void            pic_dispatch (struct trapframe *tp);
+void            sic_init(void*);
+void            sic_enable(int, ISR);
+
+// mmap.c
+uint            vma_base(struct proc*);
+int             vma_map(uint, int, int, struct file*, uint);
+int             vma_fault(uint, int);
+int             vma_prefault(uint, uint);
+int             vma_unmap_range(uint, uint);
+int             vma_fork(struct proc*);
+void            vma_exit(void);
+
+// pcache.c
+struct cpage;
+void            pcache_init(void);
+struct cpage*   pcache_get(struct inode*, uint);
+void            pcache_put(struct cpage*);
+void            pcache_share(struct cpage*);
+char*           pcache_data(struct cpage*);
+void            pcache_write(struct inode*, uint, char*, uint);
+void            pcache_inval(struct inode*);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
+int             pipeavail(struct pipe*);
+int             pipepeek(struct pipe*, char**);
 int             piperead(struct pipe*, char*, int);
+void            pipeskip(struct pipe*, int);
+uint            pipespace(struct pipe*);
+int             pipepoll(struct pipe*, int, int);
 int             pipewrite(struct pipe*, char*, int);
 
+// poll.c
+struct pollfd;
+void            pollinit(void);
+int             pollenter(void*);
+void            pollwake(void*);
+int             poll(struct pollfd*, int, int);
+
 //PAGEBREAK: 16
 // proc.c
 uint            rand();
 struct proc*    copyproc(struct proc*);
 void            exit(void);
 int             fork(void);
+int             spawn(char*, char**, int*);
+int             vfork(void);
+int             clone(uint, uint, uint, uint);
+void            syncthreads(void);
+int             futex_wait(uint, int);
+int             futex_wake(uint, int);
+void            vfork_done(void);
 int             growproc(int);
 int             kill(int);
 void            pinit(void);
@@ -151,6 +227,14 @@ int             getpinfo(struct pstat*);
 // swtch.S
 void            swtch(struct context**, struct context*);
 
+// shm.c
+struct shm;
+void            shminit(void);
+struct shm*     shmget(char*, uint);
+void            shmclose(struct shm*);
+uint            shmsize(struct shm*);
+char*           shmpage(struct shm*, uint);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
@@ -169,9 +253,10 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
-int             argstr(int, char**);
+int             checkptr(uint, uint);
+int             argstr(int, char*, int);
 int             fetchint(uint, int*);
-int             fetchstr(uint, char**);
+int             fetchstr(uint, char*, int);
 void            syscall(void);
 
 // timer.c
@@ -206,12 +291,19 @@ int             deallocuvm(pde_t*, uint, uint);
 void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
+int             shareuvm(pde_t*, char*, struct inode*, uint, uint);
+pte_t*          walkpgdir(pde_t*, const void*, int);
+int             mappages(pde_t*, void*, uint, uint, int);
 pde_t*          copyuvm(pde_t*, uint);
 void            switchuvm(struct proc*);
 int             copyout(pde_t*, uint, void*, uint);
+int             copyin(pde_t*, void*, uint, uint);
+int             copyinstr(pde_t*, char*, uint, uint);
+char*           uva2ka(pde_t*, uint);
+int             either_copyout(void*, void*, uint);
+int             either_copyin(void*, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 void*           kpt_alloc(void);
 void            init_vmm (void);
 void            kpt_freerange (uint32 low, uint32 hi);
-void            paging_init (uint phy_low, uint phy_hi);
 #endif
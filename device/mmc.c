@@ -0,0 +1,294 @@
+// driver for ARM PrimeCell Multimedia Card Interface (PL181) with an SD card
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "arm.h"
+#include "memlayout.h"
+#include "buf.h"
+
+// Commands are short and are polled. Data moves through the 16-word
+// FIFO in the interrupt handler: a transfer is started by mmc_start,
+// the handler drains (read) or fills (write) the FIFO as the card
+// asks for it, and reports the end of the transfer with ideintr. A
+// write ends on the DATAEND interrupt, when the card has the data.
+
+static volatile uint *mmc_base;
+
+#define MMC_POWER		0	// power control register
+#define MMC_CLOCK		1	// clock control register
+#define MMC_ARG			2	// argument register
+#define MMC_CMD			3	// command register
+#define MMC_RESP0		5	// response registers (RESP0 - RESP3)
+#define MMC_DTIMER		9	// data timer register
+#define MMC_DLENGTH		10	// data length register
+#define MMC_DCTRL		11	// data control register
+#define MMC_STATUS		13	// status register
+#define MMC_CLEAR		14	// clear (static bits of) status register
+#define MMC_MASK0		15	// interrupt mask register
+#define MMC_FIFO		32	// data FIFO (16 words)
+
+// bits in registers
+#define CMD_RESP		(1 << 6)	// wait for a response
+#define CMD_LONGRESP	(1 << 7)	// 136-bit response
+#define CMD_ENABLE		(1 << 10)	// enable the command path
+#define DCTRL_ENABLE	(1 << 0)	// enable the data path
+#define DCTRL_READ		(1 << 1)	// data from card to controller
+#define DCTRL_BLK512	(9 << 4)	// block size: 2^9 bytes
+
+#define ST_CMDCRCFAIL	(1 << 0)	// response received, CRC failed
+#define ST_DATACRCFAIL	(1 << 1)	// data block CRC failed
+#define ST_CMDTIMEOUT	(1 << 2)	// no response
+#define ST_DATATIMEOUT	(1 << 3)	// data timeout
+#define ST_TXUNDERRUN	(1 << 4)	// transmit FIFO underrun
+#define ST_RXOVERRUN	(1 << 5)	// receive FIFO overrun
+#define ST_CMDRESPEND	(1 << 6)	// response received, CRC ok
+#define ST_CMDSENT		(1 << 7)	// command sent (no response)
+#define ST_DATAEND		(1 << 8)	// data counter reached zero
+#define ST_TXHALFEMPTY	(1 << 14)	// transmit FIFO half empty
+#define ST_TXFIFOFULL	(1 << 16)	// transmit FIFO full
+#define ST_RXDATAAVLBL	(1 << 21)	// data available in receive FIFO
+#define ST_DATAERR		(ST_DATACRCFAIL|ST_DATATIMEOUT|ST_TXUNDERRUN|ST_RXOVERRUN)
+#define ST_CLEARALL		0x7FF
+
+// SD commands
+#define SD_GO_IDLE		0
+#define SD_ALL_SEND_CID	2
+#define SD_SEND_RCA		3
+#define SD_SELECT		7
+#define SD_SEND_IF_COND	8
+#define SD_SEND_CSD		9
+#define SD_STOP			12
+#define SD_SET_BLOCKLEN	16
+#define SD_READ_SINGLE	17
+#define SD_READ_MULTI	18
+#define SD_WRITE_SINGLE	24
+#define SD_WRITE_MULTI	25
+#define SD_APP_OP_COND	41	// after SD_APP_CMD
+#define SD_APP_CMD		55
+
+#define OCR_BUSY		(1U << 31)	// card has finished power up
+#define OCR_CCS			(1 << 30)	// high capacity: block addressing
+#define MMC_SPIN		1000000		// polling limit
+
+static int block_addr;          // card takes sector (not byte) addresses
+
+// the transfer in progress
+static struct buf **xfer_bv;
+static int xfer_n;
+static int xfer_write;
+static int xfer_words;          // words moved so far
+
+// send a command and wait for it to complete; -1 if it times out
+static int mmc_cmd (int idx, uint arg, uint flags)
+{
+    uint st;
+    int i;
+
+    st = 0;
+    mmc_base[MMC_ARG] = arg;
+    mmc_base[MMC_CMD] = idx | flags | CMD_ENABLE;
+
+    for (i = 0; i < MMC_SPIN; i++) {
+        st = mmc_base[MMC_STATUS];
+
+        if (st & (ST_CMDSENT | ST_CMDRESPEND | ST_CMDTIMEOUT | ST_CMDCRCFAIL)) {
+            break;
+        }
+    }
+
+    mmc_base[MMC_CLEAR] = ST_CMDSENT | ST_CMDRESPEND | ST_CMDTIMEOUT | ST_CMDCRCFAIL;
+
+    // R3 (the OCR) carries no CRC, so a CRC failure still has a response
+    if ((i == MMC_SPIN) || (st & ST_CMDTIMEOUT)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// number of 512-byte sectors, from the card specific data register
+static uint mmc_csd_size (void)
+{
+    uint r1, r2, csize, mult, bl_len;
+
+    r1 = mmc_base[MMC_RESP0 + 1];
+    r2 = mmc_base[MMC_RESP0 + 2];
+
+    if ((mmc_base[MMC_RESP0] >> 30) == 1) {
+        // CSD version 2.0: C_SIZE [69:48] in units of 512KB
+        csize = ((r1 & 0x3F) << 16) | (r2 >> 16);
+        return (csize + 1) * 1024;
+    }
+
+    // CSD version 1.0: C_SIZE [73:62], C_SIZE_MULT [49:47], READ_BL_LEN [83:80]
+    csize = ((r1 & 0x3FF) << 2) | (r2 >> 30);
+    mult = (r2 >> 15) & 0x07;
+    bl_len = (r1 >> 16) & 0x0F;
+
+    return ((csize + 1) << (mult + 2 + bl_len)) / 512;
+}
+
+// finish the transfer in progress and hand it back to the queue
+static void mmc_done (uint st)
+{
+    mmc_base[MMC_MASK0] = 0;
+    mmc_base[MMC_CLEAR] = ST_CLEARALL;
+    mmc_base[MMC_DCTRL] = 0;
+
+    if (xfer_n > 1) {
+        mmc_cmd(SD_STOP, 0, CMD_RESP);
+    }
+
+    if (st & ST_DATAERR) {
+        cprintf("mmc: data error, status 0x%x\n", st);
+        panic("mmc");
+    }
+
+    ideintr(SDDISK);
+}
+
+// interrupt service routine: move data between the FIFO and the bufs
+static void isr_mmc (struct trapframe *tf, int idx)
+{
+    uint st, *p;
+    int total;
+
+    total = xfer_n * 128;
+    st = mmc_base[MMC_STATUS];
+
+    if (xfer_write) {
+        while ((xfer_words < total) && !(mmc_base[MMC_STATUS] & ST_TXFIFOFULL)) {
+            p = (uint*) xfer_bv[xfer_words / 128]->data;
+            mmc_base[MMC_FIFO] = p[xfer_words % 128];
+            xfer_words++;
+        }
+
+        st = mmc_base[MMC_STATUS];
+
+        // once all data is in the FIFO, the transfer ends with the
+        // interrupt for DATAEND (or an error) as it reaches the card
+        if (!(st & (ST_DATAEND | ST_DATAERR))) {
+            if (xfer_words == total) {
+                mmc_base[MMC_MASK0] = ST_DATAEND | ST_DATAERR;
+            }
+
+            return;
+        }
+
+    } else {
+        while ((xfer_words < total) && (mmc_base[MMC_STATUS] & ST_RXDATAAVLBL)) {
+            p = (uint*) xfer_bv[xfer_words / 128]->data;
+            p[xfer_words % 128] = mmc_base[MMC_FIFO];
+            xfer_words++;
+        }
+
+        st = mmc_base[MMC_STATUS];
+
+        if ((xfer_words < total) && !(st & ST_DATAERR)) {
+            return;
+        }
+    }
+
+    mmc_done(st);
+}
+
+// start a transfer of n consecutive sectors
+static int mmc_start (struct buf **bv, int n)
+{
+    uint addr;
+    int cmd;
+
+    xfer_bv = bv;
+    xfer_n = n;
+    xfer_write = bv[0]->flags & B_DIRTY;
+    xfer_words = 0;
+
+    addr = block_addr ? bv[0]->sector : bv[0]->sector * 512;
+
+    mmc_base[MMC_CLEAR] = ST_CLEARALL;
+    mmc_base[MMC_DTIMER] = 0xFFFFFFFF;
+    mmc_base[MMC_DLENGTH] = n * 512;
+
+    if (xfer_write) {
+        cmd = (n > 1) ? SD_WRITE_MULTI : SD_WRITE_SINGLE;
+        mmc_base[MMC_DCTRL] = DCTRL_ENABLE | DCTRL_BLK512;
+        mmc_base[MMC_MASK0] = ST_TXHALFEMPTY | ST_DATAERR;
+    } else {
+        cmd = (n > 1) ? SD_READ_MULTI : SD_READ_SINGLE;
+        mmc_base[MMC_DCTRL] = DCTRL_ENABLE | DCTRL_READ | DCTRL_BLK512;
+        mmc_base[MMC_MASK0] = ST_RXDATAAVLBL | ST_DATAERR;
+    }
+
+    if (mmc_cmd(cmd, addr, CMD_RESP) < 0) {
+        panic("mmc: transfer command");
+    }
+
+    return 0;
+}
+
+static struct blkdev mmc_dev = {"sd", 0, NBCLUSTER, mmc_start};
+
+// probe and initialize the SD card; return -1 if there is none
+int mmc_init (void *base)
+{
+    uint rca;
+    int i;
+
+    mmc_base = base;
+
+    mmc_base[MMC_POWER] = 0x86;     // power on, 3.2-3.3V
+    mmc_base[MMC_CLOCK] = 0x1C6;    // enable the card clock
+    mmc_base[MMC_MASK0] = 0;
+    mmc_base[MMC_CLEAR] = ST_CLEARALL;
+
+    mmc_cmd(SD_GO_IDLE, 0, 0);
+
+    // SD 2.0 cards echo the check pattern
+    if (mmc_cmd(SD_SEND_IF_COND, 0x1AA, CMD_RESP) < 0) {
+        return -1;
+    }
+
+    // ask for high capacity support, until the card has powered up
+    for (i = 0; i < 1000; i++) {
+        if ((mmc_cmd(SD_APP_CMD, 0, CMD_RESP) < 0) ||
+            (mmc_cmd(SD_APP_OP_COND, 0x40FF8000, CMD_RESP) < 0)) {
+            return -1;
+        }
+
+        if (mmc_base[MMC_RESP0] & OCR_BUSY) {
+            break;
+        }
+
+        micro_delay(1000);
+    }
+
+    if (i == 1000) {
+        return -1;
+    }
+
+    block_addr = (mmc_base[MMC_RESP0] & OCR_CCS) != 0;
+
+    if ((mmc_cmd(SD_ALL_SEND_CID, 0, CMD_RESP | CMD_LONGRESP) < 0) ||
+        (mmc_cmd(SD_SEND_RCA, 0, CMD_RESP) < 0)) {
+        return -1;
+    }
+
+    rca = mmc_base[MMC_RESP0] & 0xFFFF0000;
+
+    if (mmc_cmd(SD_SEND_CSD, rca, CMD_RESP | CMD_LONGRESP) < 0) {
+        return -1;
+    }
+
+    mmc_dev.nsector = mmc_csd_size();
+
+    if ((mmc_cmd(SD_SELECT, rca, CMD_RESP) < 0) ||
+        (mmc_cmd(SD_SET_BLOCKLEN, 512, CMD_RESP) < 0)) {
+        return -1;
+    }
+
+    sic_enable(SIC_MMCI0, isr_mmc);
+    ideregister(SDDISK, &mmc_dev);
+
+    cprintf("mmc: sd card, %d sectors\n", mmc_dev.nsector);
+    return 0;
+}
@@ -94,3 +94,54 @@ void pic_dispatch (struct trapframe *tp)
     intstatus = vic_base[VIC_IRQSTATUS];
 }
 
+
+// The VersatilePB secondary interrupt controller (SIC) collects more
+// sources (e.g., the MMC controller) and cascades them into VIC line
+// PIC_SIC. Register offsets in the unit of 4 bytes.
+static volatile uint* sic_base;
+
+#define SIC_STATUS		0 // status of enabled interrupts
+#define SIC_ENSET		2 // enable interrupts (1 - enable it)
+#define SIC_ENCLR		3 // disable interrupts (1 - disable it)
+
+static ISR sic_isrs[NUM_INTSRC];
+
+static void sic_dispatch (struct trapframe *tp, int n)
+{
+    uint intstatus;
+    int		i;
+
+    intstatus = sic_base[SIC_STATUS];
+
+    for (i = 0; i < NUM_INTSRC; i++) {
+        if (intstatus & (1<<i)) {
+            sic_isrs[i](tp, i);
+        }
+    }
+}
+
+// initialize the SIC and hook it to the VIC
+void sic_init (void * base)
+{
+    int i;
+
+    sic_base = base;
+    sic_base[SIC_ENCLR] = 0xFFFFFFFF;
+
+    for (i = 0; i < NUM_INTSRC; i++) {
+        sic_isrs[i] = default_isr;
+    }
+
+    pic_enable (PIC_SIC, sic_dispatch);
+}
+
+// enable a secondary interrupt (with the ISR)
+void sic_enable (int n, ISR isr)
+{
+    if ((n<0) || (n >= NUM_INTSRC)) {
+        panic ("invalid interrupt source");
+    }
+
+    sic_isrs[n] = isr;
+    sic_base[SIC_ENSET] = (1 << n);
+}
@@ -26,10 +26,16 @@
 #define TIMER1          0x101E2020
 #define CLK_HZ          1000000     // the clock is 1MHZ
 
+#define MMC0            0x10005000  // PL181 MMC/SD controller
+
 #define VIC_BASE        0x10140000
 #define PIC_TIMER01     4
 #define PIC_TIMER23     5
 #define PIC_UART0       12
 #define PIC_GRAPHIC     19
+#define PIC_SIC         31          // secondary controller cascade
+
+#define SIC_BASE        0x10003000
+#define SIC_MMCI0       22
 
 #endif
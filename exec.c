@@ -7,14 +7,14 @@
 #include "elf.h"
 #include "arm.h"
 
-// load a user program for execution
-int exec (char *path, char **argv)
+// Build the user image of the program at path, with arguments argv,
+// in a new page table. Used by exec and spawn.
+int exec_load (char *path, char **argv, struct uimage *img)
 {
     struct elfhdr elf;
     struct inode *ip;
     struct proghdr ph;
     pde_t *pgdir;
-    pde_t *oldpgdir;
     char *s;
     char *last;
     int i;
@@ -22,12 +22,14 @@ int exec (char *path, char **argv)
     uint argc;
     uint sz;
     uint sp;
+    uint n;
     uint ustack[3 + MAXARG + 1];
 
     if ((ip = namei(path)) == 0) {
         return -1;
     }
 
+    pgdir = 0;
     ilock(ip);
 
     // Check ELF header
@@ -39,8 +41,6 @@ int exec (char *path, char **argv)
         goto bad;
     }
 
-    pgdir = 0;
-
     if ((pgdir = kpt_alloc()) == 0) {
         goto bad;
     }
@@ -61,11 +61,37 @@ int exec (char *path, char **argv)
             goto bad;
         }
 
+        if (ph.vaddr + ph.memsz < ph.vaddr) {
+            goto bad;
+        }
+
+        // Map the whole pages of a read-only segment from the page
+        // cache, shared with other processes running the program.
+        // The last page may be shared too if the segment has no bss.
+        n = 0;
+
+        if (!(ph.flags & ELF_PROG_FLAG_WRITE) && (ph.vaddr % PTE_SZ == 0)
+                && (ph.off % PTE_SZ == 0) && (ph.vaddr >= sz)) {
+            n = (ph.memsz == ph.filesz) ? ph.filesz : align_dn(ph.filesz, PTE_SZ);
+        }
+
+        if (n > 0) {
+            if ((sz = allocuvm(pgdir, sz, ph.vaddr)) == 0 && ph.vaddr != 0) {
+                goto bad;
+            }
+
+            if (shareuvm(pgdir, (char*) ph.vaddr, ip, ph.off, n) < 0) {
+                goto bad;
+            }
+
+            sz = ph.vaddr + align_up(n, PTE_SZ);
+        }
+
         if ((sz = allocuvm(pgdir, sz, ph.vaddr + ph.memsz)) == 0) {
             goto bad;
         }
 
-        if (loaduvm(pgdir, (char*) ph.vaddr, ip, ph.off, ph.filesz) < 0) {
+        if (ph.filesz > n && loaduvm(pgdir, (char*) ph.vaddr + n, ip, ph.off + n, ph.filesz - n) < 0) {
             goto bad;
         }
     }
@@ -102,10 +128,6 @@ int exec (char *path, char **argv)
 
     ustack[argc] = 0;
 
-    // in ARM, parameters are passed in r0 and r1
-    proc->tf->r0 = argc;
-    proc->tf->r1 = sp - (argc + 1) * 4;
-
     sp -= (argc + 1) * 4;
 
     if (copyout(pgdir, sp, ustack, (argc + 1) * 4) < 0) {
@@ -119,17 +141,13 @@ int exec (char *path, char **argv)
         }
     }
 
-    safestrcpy(proc->name, last, sizeof(proc->name));
-
-    // Commit to the user image.
-    oldpgdir = proc->pgdir;
-    proc->pgdir = pgdir;
-    proc->sz = sz;
-    proc->tf->pc = elf.entry;
-    proc->tf->sp_usr = sp;
+    safestrcpy(img->name, last, sizeof(img->name));
 
-    switchuvm(proc);
-    freevm(oldpgdir);
+    img->pgdir = pgdir;
+    img->sz = sz;
+    img->entry = elf.entry;
+    img->sp = sp;
+    img->argc = argc;
     return 0;
 
     bad: if (pgdir) {
@@ -141,3 +159,44 @@ int exec (char *path, char **argv)
     }
     return -1;
 }
+
+// load a user program for execution
+int exec (char *path, char **argv)
+{
+    struct uimage img;
+    pde_t *oldpgdir;
+
+    // the other threads would lose their memory
+    if (proc->tg->ref > 1) {
+        return -1;
+    }
+
+    if (exec_load(path, argv, &img) < 0) {
+        return -1;
+    }
+
+    // Commit to the user image. The memory mappings go with the
+    // old one.
+    vma_exit();
+    oldpgdir = proc->pgdir;
+    proc->pgdir = img.pgdir;
+    proc->sz = img.sz;
+
+    // in ARM, parameters are passed in r0 and r1
+    proc->tf->r0 = img.argc;
+    proc->tf->r1 = img.sp;
+    proc->tf->pc = img.entry;
+    proc->tf->sp_usr = img.sp;
+    safestrcpy(proc->name, img.name, sizeof(proc->name));
+
+    switchuvm(proc);
+
+    // a vfork child now has its own memory, and the parent goes on
+    if (proc->borrowed) {
+        vfork_done();
+    } else {
+        freevm(oldpgdir);
+    }
+
+    return 0;
+}
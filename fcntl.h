@@ -2,3 +2,4 @@
 #define O_WRONLY        0x001
 #define O_RDWR          0x002
 #define O_CREATE        0x200
+#define O_NONBLOCK      0x800
@@ -5,9 +5,15 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "stat.h"
+#include "mmu.h"
 #include "fs.h"
 #include "file.h"
 #include "spinlock.h"
+#include "uio.h"
+#include "poll.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 struct devsw devsw[NDEV];
 struct {
@@ -30,6 +36,7 @@ struct file* filealloc (void)
     for (f = ftable.file; f < ftable.file + NFILE; f++) {
         if (f->ref == 0) {
             f->ref = 1;
+            f->nonblock = 0;
             release(&ftable.lock);
             return f;
         }
@@ -81,6 +88,9 @@ void fileclose (struct file *f)
         begin_trans();
         iput(ff.ip);
         commit_trans();
+
+    } else if (ff.type == FD_SHM) {
+        shmclose(ff.shm);
     }
 }
 
@@ -98,29 +108,144 @@ int filestat (struct file *f, struct stat *st)
     return -1;
 }
 
+// Read up to n entries of the directory f into dst, with the type
+// and size of each. Returns the number read, 0 at the end.
+int filereaddir (struct file *f, struct direntplus *dst, int n)
+{
+    int r;
+
+    if ((f->type != FD_INODE) || (f->readable == 0)) {
+        return -1;
+    }
+
+    ilock(f->ip);
+
+    if (f->ip->type != T_DIR) {
+        iunlock(f->ip);
+        return -1;
+    }
+
+    r = readdirplus(f->ip, &f->off, dst, n);
+    iunlock(f->ip);
+
+    return r;
+}
+
+// Return which of events (POLLIN, POLLOUT) file f is ready for,
+// along with POLLHUP or POLLERR for a pipe whose other end is closed.
+// If f is not ready, enter the process to be woken when it may be.
+// Returns -1 if the process cannot wait for f.
+int filepoll (struct file *f, int events)
+{
+    struct inode *ip;
+
+    if (f->type == FD_PIPE) {
+        return pipepoll(f->pipe, f->writable, events);
+    }
+
+    events &= (f->readable ? POLLIN : 0) | (f->writable ? POLLOUT : 0);
+
+    if (f->type == FD_INODE && f->ip->type == T_DEV) {
+        ip = f->ip;
+
+        if (ip->major >= 0 && ip->major < NDEV && devsw[ip->major].poll) {
+            return devsw[ip->major].poll(ip, events);
+        }
+    }
+
+    // files do not make anybody wait
+    return events;
+}
+
 // Read from file f.
 int fileread (struct file *f, char *addr, int n)
 {
-    int r;
+    struct iovec iov;
+
+    iov.iov_base = addr;
+    iov.iov_len = n;
+
+    return filereadv(f, &iov, 1, -1);
+}
+
+// Read from file f into the cnt buffers of iov, in order. If off is
+// negative, read at the file offset and advance it; otherwise read at
+// off and leave the file offset alone, which pipes cannot do.
+int filereadv (struct file *f, struct iovec *iov, int cnt, int off)
+{
+    int i, r, n;
+    uint pos;
 
     if (f->readable == 0) {
         return -1;
     }
 
+    n = 0;
+
     if (f->type == FD_PIPE) {
-        return piperead(f->pipe, addr, n);
+        if (off >= 0 || (f->nonblock && !pipeavail(f->pipe))) {
+            return -1;
+        }
+
+        // wait for the first byte, not to fill every buffer
+        for (i = 0; i < cnt; i++) {
+            if ((n > 0) && !pipeavail(f->pipe)) {
+                break;
+            }
+
+            if ((r = piperead(f->pipe, iov[i].iov_base, iov[i].iov_len)) < 0) {
+                return -1;
+            }
+
+            n += r;
+
+            if (r != iov[i].iov_len) {
+                break;
+            }
+        }
+
+        return n;
     }
 
     if (f->type == FD_INODE) {
+        // only devices wait, and only one that can poll can be asked
+        if (f->nonblock && (f->ip->type == T_DEV) && (filepoll(f, POLLIN) & POLLIN) == 0) {
+            return -1;
+        }
+
         ilock(f->ip);
 
-        if ((r = readi(f->ip, addr, f->off, n)) > 0) {
-            f->off += r;
+        pos = (off < 0) ? f->off : off;
+
+        for (i = 0; i < cnt; i++) {
+            if ((r = readi(f->ip, iov[i].iov_base, pos, iov[i].iov_len)) < 0) {
+                if (n == 0) {
+                    n = -1;
+                }
+
+                break;
+            }
+
+            n += r;
+            pos += r;
+
+            if (r != iov[i].iov_len) {
+                break;
+            }
+        }
+
+        if (off < 0) {
+            f->off = pos;
         }
 
         iunlock(f->ip);
 
-        return r;
+        return n;
+    }
+
+    // shared memory is only accessed by mapping it
+    if (f->type == FD_SHM) {
+        return -1;
     }
 
     panic("fileread");
@@ -130,17 +255,52 @@ int fileread (struct file *f, char *addr, int n)
 // Write to file f.
 int filewrite (struct file *f, char *addr, int n)
 {
-    int r;
-    int i;
+    struct iovec iov;
+
+    iov.iov_base = addr;
+    iov.iov_len = n;
+
+    return filewritev(f, &iov, 1, -1);
+}
+
+// Write the cnt buffers of iov to file f, in order. off is as for
+// filereadv. The write is all or nothing: it returns -1 if any of
+// it fails, though the part before the failure stays written.
+int filewritev (struct file *f, struct iovec *iov, int cnt, int off)
+{
+    int i, r, n;
     int max;
-    int n1;
+    uint pos, done, room, m;
 
     if (f->writable == 0) {
         return -1;
     }
 
+    n = 0;
+
     if (f->type == FD_PIPE) {
-        return pipewrite(f->pipe, addr, n);
+        if (off >= 0) {
+            return -1;
+        }
+
+        // without waiting, write what fits, but at least a byte
+        room = f->nonblock ? pipespace(f->pipe) : 0xffffffff;
+
+        if (room == 0) {
+            return -1;
+        }
+
+        for (i = 0; (i < cnt) && (room > 0); i++, room -= m) {
+            m = min(iov[i].iov_len, room);
+
+            if (pipewrite(f->pipe, iov[i].iov_base, m) < 0) {
+                return -1;
+            }
+
+            n += m;
+        }
+
+        return n;
     }
 
     if (f->type == FD_INODE) {
@@ -150,40 +310,136 @@ int filewrite (struct file *f, char *addr, int n)
         // and 2 blocks of slop for non-aligned writes.
         // this really belongs lower down, since writei()
         // might be writing a device like the console.
-        max = ((LOGSIZE - 1 - 1 - 2) / 2) * 512;
+        // The buffers are written to one range of the file,
+        // so small ones share a transaction.
+        pos = (off < 0) ? f->off : off;
         i = 0;
+        done = 0;
+        r = 0;
+
+        while (i < cnt) {
+            begin_trans();
+            max = ((log_room() - 1 - 1 - 2) / 2) * 512;
+            ilock(f->ip);
 
-        while (i < n) {
-            n1 = n - i;
+            for (room = max; (room > 0) && (i < cnt); room -= m) {
+                m = min(iov[i].iov_len - done, room);
 
-            if (n1 > max) {
-                n1 = max;
+                if ((m > 0) && ((r = writei(f->ip, (char*)iov[i].iov_base + done, pos, m)) != m)) {
+                    break;
+                }
+
+                n += m;
+                pos += m;
+                done += m;
+
+                if (done == iov[i].iov_len) {
+                    i++;
+                    done = 0;
+                }
             }
 
-            begin_trans();
-            ilock(f->ip);
+            // writei advanced the file to where a short write stopped
+            if (r > 0 && r < m) {
+                pos += r;
+            }
 
-            if ((r = writei(f->ip, addr + i, f->off, n1)) > 0) {
-                f->off += r;
+            if (off < 0) {
+                f->off = pos;
             }
 
             iunlock(f->ip);
             commit_trans();
 
-            if (r < 0) {
+            // short only if a buffer faulted
+            if (room > 0 && i < cnt) {
+                return -1;
+            }
+        }
+
+        return n;
+    }
+
+    if (f->type == FD_SHM) {
+        return -1;
+    }
+
+    panic("filewrite");
+}
+
+// Move up to n bytes from file in to file out without copying them
+// through user space: the source is read in place, from the page
+// cache or the pipe ring, and written to out as from a kernel buffer.
+// in must be a regular file or a pipe. Like read, it returns once
+// something has moved rather than waiting on an empty pipe.
+int filesplice (struct file *in, struct file *out, int n)
+{
+    struct cpage *pg;
+    char *addr;
+    int tot, m, r;
+
+    if ((in->readable == 0) || (out->writable == 0) || (n < 0)) {
+        return -1;
+    }
+
+    // a pipe cannot take in the data held in place in its own ring
+    if ((in->type == FD_PIPE) && (out->type == FD_PIPE) && (in->pipe == out->pipe)) {
+        return -1;
+    }
+
+    for (tot = 0; tot < n; tot += m) {
+        if (in->type == FD_PIPE) {
+            if ((tot > 0) && !pipeavail(in->pipe)) {
+                break;
+            }
+
+            if ((m = pipepeek(in->pipe, &addr)) <= 0) {
+                return (tot > 0) ? tot : m;
+            }
+
+            m = min(m, n - tot);
+            r = filewrite(out, addr, m);
+            pipeskip(in->pipe, (r < 0) ? 0 : m);
+
+        } else if (in->type == FD_INODE) {
+            ilock(in->ip);
+
+            if (in->ip->type != T_FILE) {
+                iunlock(in->ip);
+                return -1;
+            }
+
+            if (in->off >= in->ip->size) {
+                iunlock(in->ip);
                 break;
             }
 
-            if (r != n1) {
-                panic("short filewrite");
+            m = min(n - tot, in->ip->size - in->off);
+            m = min(m, PTE_SZ - in->off % PTE_SZ);
+            pg = pcache_get(in->ip, in->off / PTE_SZ);
+
+            iunlock(in->ip);
+
+            if (pg == 0) {
+                return (tot > 0) ? tot : -1;
+            }
+
+            // the page is referenced, so it stays while out sleeps
+            r = filewrite(out, pcache_data(pg) + in->off % PTE_SZ, m);
+            pcache_put(pg);
+
+            if (r >= 0) {
+                in->off += m;
             }
 
-            i += r;
+        } else {
+            return -1;
         }
 
-        return i == n ? n : -1;
+        if (r < 0) {
+            return (tot > 0) ? tot : -1;
+        }
     }
 
-    panic("filewrite");
+    return tot;
 }
-
@@ -1,10 +1,12 @@
 struct file {
-    enum { FD_NONE, FD_PIPE, FD_INODE } type;
+    enum { FD_NONE, FD_PIPE, FD_INODE, FD_SHM } type;
     int          ref;   // reference count
     char         readable;
     char         writable;
+    char         nonblock;  // fail rather than wait
     struct pipe  *pipe;
     struct inode *ip;
+    struct shm   *shm;
     uint         off;
 };
 
@@ -31,6 +33,7 @@ struct inode {
 struct devsw {
     int (*read) (struct inode*, char*, int);
     int (*write)(struct inode*, char*, int);
+    int (*poll) (struct inode*, int);   // as filepoll; 0 if always ready
 };
 
 extern struct devsw devsw[];
@@ -406,6 +406,51 @@ static uint bmap (struct inode *ip, uint bn)
     panic("bmap: out of range");
 }
 
+// Map up to nb blocks of ip starting at block bn. Return how many
+// of them lie in consecutive disk blocks starting at *addr, so they
+// can be moved with one breadv.
+static uint bmaprun (struct inode *ip, uint bn, uint nb, uint *addr)
+{
+    uint n;
+
+    *addr = bmap(ip, bn);
+
+    if (nb > NBCLUSTER) {
+        nb = NBCLUSTER;
+    }
+
+    for (n = 1; n < nb && bmap(ip, bn + n) == *addr + n; n++)
+        ;
+
+    return n;
+}
+
+// Does ip keep its data in its addrs? (See DINLINE in fs.h.)
+static int isinline (struct inode *ip)
+{
+    return (ip->type == T_FILE) && (ip->major == DINLINE);
+}
+
+// Move the inline data of ip out to a block of its own.
+static void ispill (struct inode *ip)
+{
+    char data[INLINESZ];
+    struct buf *bp;
+
+    memmove(data, ip->addrs, INLINESZ);
+    memset(ip->addrs, 0, sizeof(ip->addrs));
+    ip->major = 0;
+
+    if (ip->size > 0) {
+        bp = bread(ip->dev, bmap(ip, 0));
+        memmove(bp->data, data, ip->size);
+        log_write(bp);
+        brelse(bp);
+    }
+
+    iupdate(ip);
+}
+
 // Truncate inode (discard contents).
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
@@ -417,6 +462,15 @@ static void itrunc (struct inode *ip)
     struct buf *bp;
     uint *a;
 
+    // inline data has no blocks to free
+    if (isinline(ip)) {
+        memset(ip->addrs, 0, sizeof(ip->addrs));
+        pcache_inval(ip);
+        ip->size = 0;
+        iupdate(ip);
+        return;
+    }
+
     for (i = 0; i < NDIRECT; i++) {
         if (ip->addrs[i]) {
             bfree(ip->dev, ip->addrs[i]);
@@ -439,6 +493,7 @@ static void itrunc (struct inode *ip)
         ip->addrs[NDIRECT] = 0;
     }
 
+    pcache_inval(ip);
     ip->size = 0;
     iupdate(ip);
 }
@@ -454,11 +509,48 @@ void stati (struct inode *ip, struct stat *st)
 }
 
 //PAGEBREAK!
-// Read data from inode.
+// Read n bytes at off from the data blocks of inode ip, which must be
+// within the file. dst may be a user or a kernel address.
+int readblocks (struct inode *ip, char *dst, uint off, uint n)
+{
+    uint tot, m, bn, nb, addr, i;
+    struct buf *bv[NBCLUSTER];
+    int r;
+
+    if (isinline(ip)) {
+        return (either_copyout(dst, (char*) ip->addrs + off, n) < 0) ? -1 : n;
+    }
+
+    for (tot = 0; tot < n;) {
+        bn = off / BSIZE;
+        nb = bmaprun(ip, bn, (off + n - tot - 1) / BSIZE - bn + 1, &addr);
+        breadv(ip->dev, addr, nb, bv);
+
+        for (i = 0; i < nb; i++, tot += m, off += m, dst += m) {
+            m = min(n - tot, BSIZE - off%BSIZE);
+            r = either_copyout(dst, bv[i]->data + off % BSIZE, m);
+            brelse(bv[i]);
+
+            if (r < 0) {
+                while (++i < nb) {
+                    brelse(bv[i]);
+                }
+
+                return -1;
+            }
+        }
+    }
+
+    return n;
+}
+
+// Read data from inode. dst may be a user or a kernel address.
+// File and directory data comes from the page cache.
 int readi (struct inode *ip, char *dst, uint off, uint n)
 {
+    struct cpage *p;
     uint tot, m;
-    struct buf *bp;
+    int r;
 
     if (ip->type == T_DEV) {
         if (ip->major < 0 || ip->major >= NDEV || !devsw[ip->major].read) {
@@ -476,22 +568,39 @@ int readi (struct inode *ip, char *dst, uint off, uint n)
         n = ip->size - off;
     }
 
+    // inline data is in the inode already
+    if (isinline(ip)) {
+        return readblocks(ip, dst, off, n);
+    }
+
     for (tot = 0; tot < n; tot += m, off += m, dst += m) {
-        bp = bread(ip->dev, bmap(ip, off / BSIZE));
-        m = min(n - tot, BSIZE - off%BSIZE);
-        memmove(dst, bp->data + off % BSIZE, m);
-        brelse(bp);
+        m = min(n - tot, PTE_SZ - off%PTE_SZ);
+
+        if ((p = pcache_get(ip, off / PTE_SZ)) == 0) {
+            // out of memory, go to the buffer cache directly
+            return readblocks(ip, dst, off, n - tot) < 0 ? -1 : n;
+        }
+
+        r = either_copyout(dst, pcache_data(p) + off % PTE_SZ, m);
+        pcache_put(p);
+
+        if (r < 0) {
+            return -1;
+        }
     }
 
     return n;
 }
 
 // PAGEBREAK!
-// Write data to inode.
+// Write data to inode. src may be a user or a kernel address. If
+// src faults, the bytes before the faulting block are written.
 int writei (struct inode *ip, char *src, uint off, uint n)
 {
-    uint tot, m;
-    struct buf *bp;
+    uint tot, m, bn, nb, addr, i;
+    struct buf *bv[NBCLUSTER];
+    char data[INLINESZ];
+    int r;
 
     if (ip->type == T_DEV) {
         if (ip->major < 0 || ip->major >= NDEV || !devsw[ip->major].write) {
@@ -509,12 +618,55 @@ int writei (struct inode *ip, char *src, uint off, uint n)
         return -1;
     }
 
-    for (tot = 0; tot < n; tot += m, off += m, src += m) {
-        bp = bread(ip->dev, bmap(ip, off / BSIZE));
-        m = min(n - tot, BSIZE - off%BSIZE);
-        memmove(bp->data + off % BSIZE, src, m);
-        log_write(bp);
-        brelse(bp);
+    // inline data is written with the inode, and needs no block
+    if (isinline(ip)) {
+        if (off + n > INLINESZ) {
+            ispill(ip);
+
+        } else {
+            // copy first, so a fault leaves the data as it was
+            if (either_copyin(data, src, n) < 0) {
+                return -1;
+            }
+
+            memmove((char*) ip->addrs + off, data, n);
+            pcache_write(ip, off, (char*) ip->addrs + off, n);
+
+            if (off + n > ip->size) {
+                ip->size = off + n;
+            }
+
+            iupdate(ip);
+            return n;
+        }
+    }
+
+    r = 0;
+
+    for (tot = 0; tot < n;) {
+        bn = off / BSIZE;
+        nb = bmaprun(ip, bn, (off + n - tot - 1) / BSIZE - bn + 1, &addr);
+        breadv(ip->dev, addr, nb, bv);
+
+        for (i = 0; i < nb; i++, tot += m, off += m, src += m) {
+            m = min(n - tot, BSIZE - off%BSIZE);
+
+            // a copy that faults may have changed part of the block
+            if ((r = either_copyin(bv[i]->data + off % BSIZE, src, m)) < 0) {
+                log_undo(bv[i]);
+
+                for (; i < nb; i++) {
+                    brelse(bv[i]);
+                }
+
+                n = tot;
+                break;
+            }
+
+            pcache_write(ip, off, (char*)bv[i]->data + off % BSIZE, m);
+            log_write(bv[i]);
+            brelse(bv[i]);
+        }
     }
 
     if (n > 0 && off > ip->size) {
@@ -522,6 +674,10 @@ int writei (struct inode *ip, char *src, uint off, uint n)
         iupdate(ip);
     }
 
+    if (r < 0 && n == 0) {
+        return -1;
+    }
+
     return n;
 }
 
@@ -533,18 +689,66 @@ int namecmp (const char *s, const char *t)
     return strncmp(s, t, DIRSIZ);
 }
 
+// Offset of a field in the index block of a hashed directory
+#define DIOFF(field)    ((uint) &((struct dirindex*) 0)->field)
+
+// Is directory dp hashed? (See struct dirindex.)
+int dirhashed (struct inode *dp)
+{
+    ushort zero;
+
+    if (dp->size == 0) {
+        return 0;
+    }
+
+    if (readi(dp, (char*) &zero, 0, sizeof(zero)) != sizeof(zero)) {
+        panic("dirhashed read");
+    }
+
+    return zero == 0;
+}
+
+// Set [*poff, *pend) to where the entry for name is, or would go: its
+// leaf in a hashed directory, anywhere in a plain one.
+static void dirrange (struct inode *dp, char *name, uint *poff, uint *pend)
+{
+    ushort depth, leaf;
+    uint slot;
+
+    if (!dirhashed(dp)) {
+        *poff = 0;
+        *pend = dp->size;
+        return;
+    }
+
+    if (readi(dp, (char*) &depth, DIOFF(depth), sizeof(depth)) != sizeof(depth)) {
+        panic("dirrange depth");
+    }
+
+    slot = dirhash(name) & ((1 << depth) - 1);
+
+    if (readi(dp, (char*) &leaf, DIOFF(leaf[slot]), sizeof(leaf)) != sizeof(leaf)) {
+        panic("dirrange leaf");
+    }
+
+    *poff = leaf * BSIZE;
+    *pend = *poff + BSIZE;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 struct inode* dirlookup (struct inode *dp, char *name, uint *poff)
 {
-    uint off, inum;
+    uint off, end, inum;
     struct dirent de;
 
     if (dp->type != T_DIR) {
         panic("dirlookup not DIR");
     }
 
-    for (off = 0; off < dp->size; off += sizeof(de)) {
+    dirrange(dp, name, &off, &end);
+
+    for (; off < end; off += sizeof(de)) {
         if (readi(dp, (char*) &de, off, sizeof(de)) != sizeof(de)) {
             panic("dirlink read");
         }
@@ -567,10 +771,181 @@ struct inode* dirlookup (struct inode *dp, char *name, uint *poff)
     return 0;
 }
 
+// Read up to n entries of the locked directory dp into dst, starting
+// at *poff and advancing it past them. The type and size of each
+// entry come straight from its inode block in the buffer cache,
+// without taking the inode into the inode cache and locking it.
+// Return the number of entries read.
+int readdirplus (struct inode *dp, uint *poff, struct direntplus *dst, int n)
+{
+    struct dirent de;
+    struct dinode *dip;
+    struct buf *bp;
+    int cnt;
+
+    // the index block holds no entries
+    if ((*poff < BSIZE) && dirhashed(dp)) {
+        *poff = BSIZE;
+    }
+
+    for (cnt = 0; (cnt < n) && (*poff < dp->size); *poff += sizeof(de)) {
+        if (readi(dp, (char*) &de, *poff, sizeof(de)) != sizeof(de)) {
+            panic("readdirplus read");
+        }
+
+        if (de.inum == 0) {
+            continue;
+        }
+
+        bp = bread(dp->dev, IBLOCK(de.inum));
+        dip = (struct dinode*) bp->data + de.inum % IPB;
+
+        dst[cnt].type = dip->type;
+        dst[cnt].size = dip->size;
+        brelse(bp);
+
+        dst[cnt].inum = de.inum;
+        memmove(dst[cnt].name, de.name, DIRSIZ);
+        cnt++;
+    }
+
+    return cnt;
+}
+
+// Most blocks a dirconvert or dirsplit logs: the bitmap, the
+// indirect block (when the new leaf is the first past NDIRECT), two
+// directory blocks, the index and the inode.
+#define DIRGROW 6
+
+// Turn the plain, full, one-block directory dp into a hashed one
+// with two leaves. Returns -1 if there is no memory.
+static int dirconvert (struct inode *dp)
+{
+    struct dirindex *di;
+    struct dirent *old, *leaf[2];
+    int i, b, n[2];
+    char *mem;
+
+    if ((mem = alloc_zpage()) == 0) {
+        return -1;
+    }
+
+    di = (struct dirindex*) mem;
+    old = (struct dirent*) (mem + BSIZE);
+    leaf[0] = (struct dirent*) (mem + 2*BSIZE);
+    leaf[1] = (struct dirent*) (mem + 3*BSIZE);
+
+    if (readi(dp, (char*) old, 0, BSIZE) != BSIZE) {
+        panic("dirconvert read");
+    }
+
+    n[0] = n[1] = 0;
+
+    for (i = 0; i < DPB; i++) {
+        if (old[i].inum != 0) {
+            b = dirhash(old[i].name) & 1;
+            leaf[b][n[b]++] = old[i];
+        }
+    }
+
+    di->depth = 1;
+
+    for (i = 0; i < 2; i++) {
+        di->leaf[i] = i + 1;
+        di->ldepth[i] = 1;
+    }
+
+    // the leaves go after the old block, then the index replaces it
+    if ((writei(dp, (char*) leaf[0], BSIZE, BSIZE) != BSIZE)
+            || (writei(dp, (char*) leaf[1], 2*BSIZE, BSIZE) != BSIZE)
+            || (writei(dp, (char*) di, 0, BSIZE) != BSIZE)) {
+        panic("dirconvert write");
+    }
+
+    free_page(mem);
+    return 0;
+}
+
+// Split the full leaf that name hashes to in the hashed directory dp.
+// Returns -1 if the index cannot grow or dp cannot take another block.
+static int dirsplit (struct inode *dp, char *name)
+{
+    struct dirindex *di;
+    struct dirent *old, *new;
+    uint slot, ob, nb, d, i, j;
+    char *mem;
+
+    if ((mem = alloc_zpage()) == 0) {
+        return -1;
+    }
+
+    di = (struct dirindex*) mem;
+    old = (struct dirent*) (mem + BSIZE);
+    new = (struct dirent*) (mem + 2*BSIZE);
+
+    if (readi(dp, (char*) di, 0, BSIZE) != BSIZE) {
+        panic("dirsplit read");
+    }
+
+    slot = dirhash(name) & ((1 << di->depth) - 1);
+    d = di->ldepth[slot];
+    nb = dp->size / BSIZE;
+
+    if (((d == di->depth) && (di->depth == DIRMAXDEPTH)) || (nb >= MAXFILE)) {
+        free_page(mem);
+        return -1;
+    }
+
+    // the leaf uses every bit the index has: double the index
+    if (d == di->depth) {
+        for (i = 0; i < (1 << d); i++) {
+            di->leaf[i + (1 << d)] = di->leaf[i];
+            di->ldepth[i + (1 << d)] = di->ldepth[i];
+        }
+
+        di->depth++;
+    }
+
+    // names with hash bit d set move to the new leaf
+    ob = di->leaf[slot];
+
+    if (readi(dp, (char*) old, ob * BSIZE, BSIZE) != BSIZE) {
+        panic("dirsplit leaf");
+    }
+
+    for (i = j = 0; i < DPB; i++) {
+        if ((old[i].inum != 0) && ((dirhash(old[i].name) >> d) & 1)) {
+            new[j++] = old[i];
+            memset(&old[i], 0, sizeof(old[i]));
+        }
+    }
+
+    for (i = 0; i < (1 << di->depth); i++) {
+        if (di->leaf[i] == ob) {
+            di->ldepth[i] = d + 1;
+
+            if ((i >> d) & 1) {
+                di->leaf[i] = nb;
+            }
+        }
+    }
+
+    if ((writei(dp, (char*) new, nb * BSIZE, BSIZE) != BSIZE)
+            || (writei(dp, (char*) old, ob * BSIZE, BSIZE) != BSIZE)
+            || (writei(dp, (char*) di, 0, BSIZE) != BSIZE)) {
+        panic("dirsplit write");
+    }
+
+    free_page(mem);
+    return 0;
+}
+
 // Write a new directory entry (name, inum) into the directory dp.
+// Returns -1 if name is present, or if there is no room for it.
 int dirlink (struct inode *dp, char *name, uint inum)
 {
-    int off;
+    uint off, end;
+    int grown;
     struct dirent de;
     struct inode *ip;
 
@@ -580,15 +955,33 @@ int dirlink (struct inode *dp, char *name, uint inum)
         return -1;
     }
 
-    // Look for an empty dirent.
-    for (off = 0; off < dp->size; off += sizeof(de)) {
-        if (readi(dp, (char*) &de, off, sizeof(de)) != sizeof(de)) {
-            panic("dirlink read");
+    // Look for an empty dirent. A full plain directory is hashed and
+    // a full leaf split; twice at most, to bound the transaction.
+    for (grown = 0;; grown++) {
+        dirrange(dp, name, &off, &end);
+
+        for (; off < end; off += sizeof(de)) {
+            if (readi(dp, (char*) &de, off, sizeof(de)) != sizeof(de)) {
+                panic("dirlink read");
+            }
+
+            if (de.inum == 0) {
+                break;
+            }
         }
 
-        if (de.inum == 0) {
+        // a plain directory grows to one block
+        if ((off < end) || (dp->size < BSIZE) || (dp->size > BSIZE && !dirhashed(dp))) {
             break;
         }
+
+        if ((grown == 2) || (log_room() < DIRGROW)) {
+            return -1;
+        }
+
+        if (dirhashed(dp) ? dirsplit(dp, name) < 0 : dirconvert(dp) < 0) {
+            return -1;
+        }
     }
 
     strncpy(de.name, name, DIRSIZ);
@@ -659,9 +1052,9 @@ static struct inode* namex (char *path, int nameiparent, char *name)
     struct inode *ip, *next;
 
     if (*path == '/') {
-        ip = iget(ROOTDEV, ROOTINO);
+        ip = iget(rootdev, ROOTINO);
     } else {
-        ip = idup(proc->cwd);
+        ip = idup(proc->tg->cwd);
     }
 
     while ((path = skipelem(path, name)) != 0) {
@@ -33,6 +33,13 @@ struct dinode {
     uint    addrs[NDIRECT+1]; // Data block addresses
 };
 
+// A small regular file keeps its data in the addrs of its dinode
+// instead of in a block of its own, and says so with major (which
+// only devices use otherwise) set to DINLINE. writei moves the data
+// out to a block when the file grows past INLINESZ bytes.
+#define DINLINE       1
+#define INLINESZ      ((NDIRECT+1) * sizeof(uint))
+
 // Inodes per block.
 #define IPB           (BSIZE / sizeof(struct dinode))
 
@@ -53,3 +60,47 @@ struct dirent {
     char    name[DIRSIZ];
 };
 
+#define DPB           (BSIZE / sizeof(struct dirent))
+
+// A directory that outgrows one block is hashed (extendible hashing,
+// as in the ext3 htree). Block 0 holds a dirindex, and each entry
+// lives in the leaf block that the low depth bits of the hash of its
+// name select. Leaves are ordinary blocks of dirents. A leaf that
+// fills up is split in two by one more bit of the hash, doubling the
+// index first if the leaf already used all depth bits. A directory
+// that fits in one block stays a plain array of dirents, which starts
+// with "." and so never with an inum of 0.
+#define DIRMAXDEPTH   7
+#define DIRNSLOT      (1 << DIRMAXDEPTH)
+
+struct dirindex {
+    ushort  zero;               // 0, where a plain directory has "."
+    ushort  depth;              // hash bits in use: 1<<depth slots
+    ushort  leaf[DIRNSLOT];     // block of the leaf for each slot
+    uchar   ldepth[DIRNSLOT];   // hash bits all names in that leaf share
+};
+
+// FNV-1a hash of a directory entry name.
+static inline uint dirhash (char *name)
+{
+    uint h;
+    int i;
+
+    h = 2166136261U;
+
+    for (i = 0; (i < DIRSIZ) && name[i]; i++) {
+        h = (h ^ (uchar) name[i]) * 16777619;
+    }
+
+    return h;
+}
+
+// A directory entry with the type and size of its inode, as
+// readdirplus returns them.
+struct direntplus {
+    uint    size;
+    ushort  inum;
+    short   type;
+    char    name[DIRSIZ];
+};
+
@@ -0,0 +1,222 @@
+// Block device request queue.
+//
+// Each block device driver registers a struct blkdev for its device
+// number. iderwv queues bufs on the device, sorted by sector, and
+// sleeps until they are done. The queue is served as a one-way
+// elevator (C-LOOK): the next transfer starts at the lowest queued
+// sector at or above the end of the previous one, wrapping around to
+// the lowest sector. Queued bufs for consecutive sectors that move in
+// the same direction are merged into one transfer of up to maxrun
+// sectors, even if they came from different callers. The driver
+// reports the end of a transfer with ideintr, normally from its
+// interrupt handler, which wakes the waiters and starts the next one.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "buf.h"
+#include "arm.h"
+#include "memlayout.h"
+
+struct disk {
+    struct blkdev *drv;
+    struct buf *queue;              // waiting bufs, sorted by sector
+    struct buf *active[NBCLUSTER];  // bufs of the transfer in progress
+    int        nactive;
+    uint       next;                // elevator position
+};
+
+static struct spinlock idelock;
+static struct disk disks[NDISK];
+
+int rootdev;    // device number of file system root disk
+
+// Probe the disks and pick the root device: the SD card if QEMU has
+// one attached (its contents persist across runs), else the image
+// linked into the kernel.
+void ideinit(void)
+{
+    initlock(&idelock, "ide");
+    memdisk_init();
+
+    if (mmc_init(P2V(MMC0)) == 0) {
+        rootdev = SDDISK;
+    } else if (idepresent(MEMDISK)) {
+        rootdev = MEMDISK;
+    } else {
+        panic("ideinit: no root disk");
+    }
+
+    cprintf("root file system on %s\n", disks[rootdev].drv->name);
+}
+
+// Make drv the driver for block device dev.
+void ideregister(int dev, struct blkdev *drv)
+{
+    if (dev <= 0 || dev >= NDISK || drv->maxrun <= 0 || drv->maxrun > NBCLUSTER) {
+        panic("ideregister");
+    }
+
+    disks[dev].drv = drv;
+}
+
+// Return 1 if dev has a driver.
+int idepresent(int dev)
+{
+    return dev > 0 && dev < NDISK && disks[dev].drv != 0;
+}
+
+// Insert b into the sorted queue of d. Caller holds idelock.
+static void idequeue(struct disk *d, struct buf *b)
+{
+    struct buf **pp;
+
+    for (pp = &d->queue; *pp && (*pp)->sector <= b->sector; pp = &(*pp)->qnext)
+        ;
+
+    b->qnext = *pp;
+    *pp = b;
+}
+
+// Mark the transfer in progress done and wake up its waiters.
+static void idedone(struct disk *d)
+{
+    struct buf *b;
+    int i;
+
+    for (i = 0; i < d->nactive; i++) {
+        b = d->active[i];
+        b->flags = (b->flags | B_VALID) & ~B_DIRTY;
+        wakeup(b);
+    }
+
+    d->nactive = 0;
+}
+
+// Start the next transfer if the device is idle. Transfers the driver
+// completes synchronously are finished here. Caller holds idelock.
+static void idestart(struct disk *d)
+{
+    struct buf **pp, **start, *b;
+    int write;
+
+    while (d->nactive == 0 && d->queue) {
+        // C-LOOK: first buf at or above the elevator, else the lowest
+        for (start = &d->queue; *start && (*start)->sector < d->next; start = &(*start)->qnext)
+            ;
+
+        if (*start == 0) {
+            start = &d->queue;
+        }
+
+        // unlink the run of consecutive sectors beginning there
+        write = (*start)->flags & B_DIRTY;
+        pp = start;
+
+        do {
+            b = *pp;
+            *pp = b->qnext;
+            b->qnext = 0;
+            d->active[d->nactive++] = b;
+        } while (d->nactive < d->drv->maxrun && *pp && (*pp)->sector == b->sector + 1
+                 && ((*pp)->flags & B_DIRTY) == write);
+
+        d->next = b->sector + 1;
+
+        if (d->drv->start(d->active, d->nactive)) {
+            idedone(d);
+        }
+    }
+}
+
+// Called by the driver of dev when its transfer has completed.
+void ideintr(int dev)
+{
+    struct disk *d;
+
+    d = &disks[dev];
+
+    acquire(&idelock);
+
+    if (d->nactive == 0) {
+        release(&idelock);
+        return;
+    }
+
+    idedone(d);
+    idestart(d);
+    release(&idelock);
+}
+
+// Sync n bufs with disk. They need not be consecutive but must be
+// on the same device.
+// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
+// Else if B_VALID is not set, read buf from disk, set B_VALID.
+void iderwv(struct buf **bv, int n)
+{
+    struct disk *d;
+    struct buf *b;
+    int i;
+
+    if (n <= 0 || n > NBCLUSTER) {
+        panic("iderwv: bad count");
+    }
+
+    if (!idepresent(bv[0]->dev)) {
+        panic("iderw: no such disk");
+    }
+
+    d = &disks[bv[0]->dev];
+
+    for (i = 0; i < n; i++) {
+        b = bv[i];
+
+        if(!(b->flags & B_BUSY)) {
+            panic("iderw: buf not busy");
+        }
+
+        if((b->flags & (B_VALID|B_DIRTY)) == B_VALID) {
+            panic("iderw: nothing to do");
+        }
+
+        if(b->dev != bv[0]->dev) {
+            panic("iderwv: mixed disks");
+        }
+
+        if(b->sector >= d->drv->nsector) {
+            panic("iderw: sector out of range");
+        }
+    }
+
+    acquire(&idelock);
+
+    for (i = 0; i < n; i++) {
+        idequeue(d, bv[i]);
+    }
+
+    idestart(d);
+
+    // Wait for the requests to finish. Before the first process
+    // runs there is nobody to sleep, so let the interrupt in instead.
+    for (i = 0; i < n; i++) {
+        while ((bv[i]->flags & (B_VALID|B_DIRTY)) != B_VALID) {
+            if (proc == 0) {
+                release(&idelock);
+                acquire(&idelock);
+            } else {
+                sleep(bv[i], &idelock);
+            }
+        }
+    }
+
+    release(&idelock);
+}
+
+// Sync buf with disk.
+void iderw(struct buf *b)
+{
+    iderwv(&b, 1);
+}
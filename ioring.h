@@ -0,0 +1,46 @@
+// Submission and completion rings for ring_enter.
+//
+// The program fills submission entries and advances sqtail; the
+// kernel does them in order in ring_enter, advancing sqhead and
+// adding a completion for each at cqtail. The program takes the
+// completions from cqhead. The indices count entries from the start
+// and wrap around freely. One ring_enter does a whole batch of
+// operations for the price of one trap.
+
+#define IO_NOP          0
+#define IO_READ         1       // read len bytes from fd into addr
+#define IO_WRITE        2       // write len bytes at addr to fd
+#define IO_OPEN         3       // open the path at addr, with len as the mode
+#define IO_CLOSE        4       // close fd
+
+// ring_enter flags
+#define IORING_NOWAIT   0x1     // stop at an entry that would wait for a pipe
+
+#define IORING_MAX      256     // most entries in each queue
+
+struct iosqe {
+    int op;
+    int fd;
+    void *addr;
+    uint len;
+    int off;                    // file offset, or -1 for the file's own
+    uint data;                  // copied to the completion
+};
+
+struct iocqe {
+    uint data;
+    int res;                    // what the system call would return
+};
+
+struct ioring {
+    uint sqhead;                // next entry the kernel takes
+    uint sqtail;                // next entry the program fills
+    uint cqhead;                // next completion the program takes
+    uint cqtail;                // next completion the kernel fills
+    uint size;                  // entries in each queue, a power of 2
+    uint pad[3];
+    struct iosqe sq[];          // followed by size struct iocqe
+};
+
+#define IORING_CQ(r)    ((struct iocqe*)((r)->sq + (r)->size))
+#define IORING_SZ(n)    (sizeof(struct ioring) + (n) * (sizeof(struct iosqe) + sizeof(struct iocqe)))
@@ -54,10 +54,18 @@ int memcmp(const void *v1, const void *v2, uint n)
     return 0;
 }
 
+// lib/memcpy.S: word aligned block copies, forward and from the end
+void memcpy_fwd (void *dst, const void *src, uint n);
+void memcpy_bwd (void *dst_end, const void *src_end, uint n);
+
+// If src and dst are equally aligned, move the bytes up to a word
+// boundary one at a time and the words in between with ldm/stm
+// bursts. Otherwise, and for the leftover bytes, copy bytes.
 void* memmove(void *dst, const void *src, uint n)
 {
     const char *s;
     char *d;
+    uint w;
 
     s = src;
     d = dst;
@@ -66,11 +74,37 @@ void* memmove(void *dst, const void *src, uint n)
         s += n;
         d += n;
 
+        if ((((uint)s ^ (uint)d) & 3) == 0) {
+            for (; (n > 0) && ((uint)d & 3); n--) {
+                *--d = *--s;
+            }
+
+            if ((w = n & ~3) != 0) {
+                memcpy_bwd(d, s, w);
+                d -= w;
+                s -= w;
+                n -= w;
+            }
+        }
+
         while(n-- > 0) {
             *--d = *--s;
         }
 
     } else {
+        if ((((uint)s ^ (uint)d) & 3) == 0) {
+            for (; (n > 0) && ((uint)d & 3); n--) {
+                *d++ = *s++;
+            }
+
+            if ((w = n & ~3) != 0) {
+                memcpy_fwd(d, s, w);
+                d += w;
+                s += w;
+                n -= w;
+            }
+        }
+
         while(n-- > 0) {
             *d++ = *s++;
         }
@@ -29,7 +29,8 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Log appends only update the cached log block; commit writes all
+// of them to disk with clustered requests before the header.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged sector #s before commit.
@@ -59,29 +60,60 @@ void initlog(void)
     }
 
     initlock(&log.lock, "log");
-    readsb(ROOTDEV, &sb);
+    readsb(rootdev, &sb);
     log.start = sb.size - sb.nlog;
     log.size = sb.nlog;
-    log.dev = ROOTDEV;
+    log.dev = rootdev;
     recover_from_log();
 }
 
 // Copy committed blocks from log to their home location
 static void install_trans(void)
 {
-    int tail;
-    struct buf *lbuf;
+    int tail, n, i;
+    struct buf *lbuf[NBCLUSTER];
     struct buf *dbuf;
 
-    for (tail = 0; tail < log.lh.n; tail++) {
-        lbuf = bread(log.dev, log.start+tail+1); // read log block
-        dbuf = bread(log.dev, log.lh.sector[tail]); // read dst
+    for (tail = 0; tail < log.lh.n; tail += n) {
+        n = log.lh.n - tail;
+
+        if (n > NBCLUSTER) {
+            n = NBCLUSTER;
+        }
+
+        breadv(log.dev, log.start+tail+1, n, lbuf); // read log blocks
+
+        for (i = 0; i < n; i++) {
+            dbuf = bread(log.dev, log.lh.sector[tail+i]); // read dst
+
+            memmove(dbuf->data, lbuf[i]->data, BSIZE);  // copy block to dst
+
+            bwrite(dbuf);  // write dst to disk
+            brelse(lbuf[i]);
+            brelse(dbuf);
+        }
+    }
+}
+
+// Write the cached log blocks of the current transaction to disk
+static void write_log(void)
+{
+    int tail, n, i;
+    struct buf *lbuf[NBCLUSTER];
+
+    for (tail = 0; tail < log.lh.n; tail += n) {
+        n = log.lh.n - tail;
+
+        if (n > NBCLUSTER) {
+            n = NBCLUSTER;
+        }
 
-        memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+        breadv(log.dev, log.start+tail+1, n, lbuf);
+        bwritev(lbuf, n);
 
-        bwrite(dbuf);  // write dst to disk
-        brelse(lbuf);
-        brelse(dbuf);
+        for (i = 0; i < n; i++) {
+            brelse(lbuf[i]);
+        }
     }
 }
 
@@ -148,6 +180,7 @@ void begin_trans(void)
 void commit_trans(void)
 {
     if (log.lh.n > 0) {
+        write_log();     // Write logged blocks to disk
         write_head();    // Write header to disk -- the real commit
         install_trans(); // Now install writes to home locations
         log.lh.n = 0;
@@ -160,6 +193,16 @@ void commit_trans(void)
     release(&log.lock);
 }
 
+// Return how many more blocks the current transaction can log. The
+// log on disk may be smaller than LOGSIZE: it was made by mkfs.
+int log_room(void)
+{
+    int max;
+
+    max = (log.size - 1 < LOGSIZE) ? log.size - 1 : LOGSIZE;
+    return max - log.lh.n;
+}
+
 // Caller has modified b->data and is done with the buffer.
 // Append the block to the log and record the block number,
 // but don't write the log header (which would commit the write).
@@ -191,7 +234,7 @@ void log_write(struct buf *b)
     lbuf = bread(b->dev, log.start+i+1);
 
     memmove(lbuf->data, b->data, BSIZE);
-    bwrite(lbuf);
+    lbuf->flags |= B_DIRTY; // keep cached until write_log
     brelse(lbuf);
 
     if (i == log.lh.n) {
@@ -201,6 +244,27 @@ void log_write(struct buf *b)
     b->flags |= B_DIRTY; // XXX prevent eviction
 }
 
+// The caller changed b->data, but the change must not stand (a copy
+// from user memory failed partway). Put back what b held: the copy
+// logged by this transaction, or else what is on disk.
+void log_undo(struct buf *b)
+{
+    struct buf *lbuf;
+    int i;
+
+    for (i = 0; i < log.lh.n; i++) {
+        if (b->dev == log.dev && log.lh.sector[i] == b->sector) {
+            lbuf = bread(b->dev, log.start+i+1);
+            memmove(b->data, lbuf->data, BSIZE);
+            brelse(lbuf);
+            return;
+        }
+    }
+
+    b->flags &= ~(B_VALID | B_DIRTY);
+    iderw(b);
+}
+
 //PAGEBREAK!
 // Blank page.
 
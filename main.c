@@ -29,21 +29,24 @@ void kmain (void)
     init_vmm ();
     kpt_freerange (align_up(&end, PT_SZ), vectbl);
     kpt_freerange (vectbl + PT_SZ, P2V_WO(INIT_KERNMAP));
-    paging_init (INIT_KERNMAP, PHYSTOP);
     
     kmem_init ();
     kmem_init2(P2V(INIT_KERNMAP), P2V(PHYSTOP));
     
     trap_init ();				// vector table and stacks for models
     pic_init (P2V(VIC_BASE));	// interrupt controller
+    sic_init (P2V(SIC_BASE));	// secondary interrupt controller
     uart_enable_rx ();			// interrupt for uart
     consoleinit ();				// console
     pinit ();					// process (locks)
 
     binit ();					// buffer cache
+    pcache_init ();				// page cache
     fileinit ();				// file table
+    shminit ();					// shared memory segments
+    pollinit ();				// poll wait queues
     iinit ();					// inode cache
-    ideinit ();					// ide (memory block device)
+    ideinit ();					// block devices and the root disk
     timer_init (HZ);			// the timer (ticker)
 
 
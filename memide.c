@@ -9,55 +9,42 @@
 #include "spinlock.h"
 #include "buf.h"
 
-// a file system image, embeded
-extern uchar _binary_fs_img_start[], _binary_fs_img_size[];
+// a file system image, embeded. The kernel may be linked without
+// one (make MEMFS=0), in which case both symbols are 0.
+extern uchar _binary_fs_img_start[] __attribute__((weak));
+extern uchar _binary_fs_img_size[] __attribute__((weak));
 
-static int disksize;
 static uchar *memdisk;
 
-void ideinit(void)
-{
-    memdisk = _binary_fs_img_start;
-    disksize = (uint)_binary_fs_img_size/512;
-}
-
-// Interrupt handler.
-void ideintr(void)
-{
-    // no-op
-}
-
-// Sync buf with disk.
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
-void iderw(struct buf *b)
+// Copy a run of bufs to or from the image. This never has to wait,
+// so the transfer is complete when it returns.
+static int memdisk_start(struct buf **bv, int n)
 {
     uchar *p;
+    int i;
 
-    if(!(b->flags & B_BUSY)) {
-        panic("iderw: buf not busy");
-    }
-
-    if((b->flags & (B_VALID|B_DIRTY)) == B_VALID) {
-        panic("iderw: nothing to do");
-    }
+    p = memdisk + bv[0]->sector*512;
 
-    if(b->dev != 1) {
-        panic("iderw: request not for disk 1");
+    for (i = 0; i < n; i++, p += 512) {
+        if(bv[i]->flags & B_DIRTY){
+            memmove(p, bv[i]->data, 512);
+        } else {
+            memmove(bv[i]->data, p, 512);
+        }
     }
 
-    if(b->sector >= disksize) {
-        panic("iderw: sector out of range");
-    }
+    return 1;
+}
 
-    p = memdisk + b->sector*512;
+static struct blkdev memdisk_dev = {"memdisk", 0, NBCLUSTER, memdisk_start};
 
-    if(b->flags & B_DIRTY){
-        b->flags &= ~B_DIRTY;
-        memmove(p, b->data, 512);
-    } else {
-        memmove(b->data, p, 512);
+void memdisk_init(void)
+{
+    if (_binary_fs_img_size == 0) {
+        return;
     }
 
-    b->flags |= B_VALID;
+    memdisk = _binary_fs_img_start;
+    memdisk_dev.nsector = (uint)_binary_fs_img_size/512;
+    ideregister(MEMDISK, &memdisk_dev);
 }
@@ -0,0 +1,9 @@
+// mmap protection and flags
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+
+#define MAP_SHARED      0x01    // writes reach the file and other processes
+#define MAP_PRIVATE     0x02    // writes are private to the process
+#define MAP_ANONYMOUS   0x20    // zeroed memory, not backed by a file
+
+#define MAP_FAILED      ((void*)-1)
@@ -0,0 +1,515 @@
+// Memory mappings.
+//
+// mmap maps files and anonymous memory into a process above its
+// heap. Mappings are placed top-down from UADDR_SZ, and the heap may
+// not grow into them. Each one is described by a struct vma in the
+// proc. Pages are put in on demand, by vma_fault, when the process
+// first touches them (or passes them to a system call):
+// * anonymous memory gets a zeroed page;
+// * shared memory segments (shm.c) map their own pages;
+// * file pages come from the page cache. A shared mapping maps the
+//   cached page itself, so all processes, and read() and write(),
+//   see the same memory. The page is mapped read-only until the
+//   first write, which makes it writable and so marks it dirty, and
+//   dirty pages are written back to the file when they are unmapped.
+//   A private mapping maps the cached page read-only and copies it
+//   on the first write.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "fs.h"
+#include "file.h"
+#include "mman.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Return the mapping of p that contains va, or 0.
+static struct vma* vma_find (struct proc *p, uint va)
+{
+    struct vma *v;
+
+    for (v = p->vmas; v < p->vmas + NVMA; v++) {
+        if (v->end && (va >= v->start) && (va < v->end)) {
+            return v;
+        }
+    }
+
+    return 0;
+}
+
+// Return the lowest mapped address of p, the limit for its heap.
+uint vma_base (struct proc *p)
+{
+    struct vma *v;
+    uint base;
+
+    base = UADDR_SZ;
+
+    for (v = p->vmas; v < p->vmas + NVMA; v++) {
+        if (v->end && (v->start < base)) {
+            base = v->start;
+        }
+    }
+
+    return base;
+}
+
+// Find room for len bytes: the highest gap between the heap and
+// UADDR_SZ that is large enough. Return 0 if there is none.
+static uint vma_place (uint len)
+{
+    struct vma *v;
+    uint end, next;
+
+    for (end = UADDR_SZ; (end >= len) && (end - len >= align_up(proc->sz, PTE_SZ)); end = next) {
+        // lowest mapping that overlaps [end - len, end)
+        next = 0;
+
+        for (v = proc->vmas; v < proc->vmas + NVMA; v++) {
+            if (v->end && (v->start < end) && (v->end > end - len) && (!next || (v->start < next))) {
+                next = v->start;
+            }
+        }
+
+        if (next == 0) {
+            return end - len;
+        }
+    }
+
+    return 0;
+}
+
+// Map len bytes of f from offset off (anonymous memory if f is 0).
+// Return the address of the mapping or -1.
+int vma_map (uint len, int prot, int flags, struct file *f, uint off)
+{
+    struct vma *v, *free;
+    uint start;
+
+    len = align_up(len, PTE_SZ);
+
+    if (proc->borrowed) {
+        return -1;
+    }
+
+    if ((len == 0) || (len >= UADDR_SZ) || !(prot & PROT_READ) || (off % PTE_SZ)) {
+        return -1;
+    }
+
+    if (((flags & (MAP_SHARED | MAP_PRIVATE)) == 0) || ((flags & (MAP_SHARED | MAP_PRIVATE)) == (MAP_SHARED | MAP_PRIVATE))) {
+        return -1;
+    }
+
+    if (f) {
+        if (!f->readable || (off + len < off)) {
+            return -1;
+        }
+
+        // a shared writable mapping writes to the file
+        if ((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable) {
+            return -1;
+        }
+
+        // shared memory segments can only be mapped shared, in range
+        if ((f->type == FD_SHM) && (!(flags & MAP_SHARED) || (off + len > shmsize(f->shm)))) {
+            return -1;
+        }
+
+        if ((f->type != FD_INODE) && (f->type != FD_SHM)) {
+            return -1;
+        }
+    }
+
+    free = 0;
+
+    for (v = proc->vmas; v < proc->vmas + NVMA; v++) {
+        if (v->end == 0) {
+            free = v;
+            break;
+        }
+    }
+
+    if ((free == 0) || ((start = vma_place(len)) == 0)) {
+        return -1;
+    }
+
+    free->start = start;
+    free->end = start + len;
+    free->prot = prot;
+    free->flags = flags;
+    free->f = f ? filedup(f) : 0;
+    free->off = off;
+
+    return start;
+}
+
+// Put in the page of the current process at va, for writing if
+// write. Return -1 if va is not mapped or the access is not allowed.
+int vma_fault (uint va, int write)
+{
+    struct vma *v;
+    struct cpage *cp;
+    struct inode *ip;
+    pte_t *pte;
+    char *mem, *old;
+    uint off;
+    int ap;
+
+    if (((v = vma_find(proc, va)) == 0) || (write && !(v->prot & PROT_WRITE))) {
+        return -1;
+    }
+
+    va = align_dn(va, PTE_SZ);
+    pte = walkpgdir(proc->pgdir, (char*) va, 0);
+
+    if (pte && (*pte & PE_TYPES)) {
+        // only a read-only page can take a fault once it is in
+        if (!write || (PTE_AP(*pte) != AP_KUR)) {
+            return -1;
+        }
+
+        // the first write to a shared file page: it is dirty now
+        if (v->flags & MAP_SHARED) {
+            old = p2v(PTE_ADDR(*pte));
+            *pte = 0;
+            mappages(proc->pgdir, (char*) va, PTE_SZ, v2p(old), AP_KU);
+            switchuvm(proc);
+
+            return 0;
+        }
+
+        // copy a private page for writing
+
+        if ((mem = alloc_page()) == 0) {
+            return -1;
+        }
+
+        old = p2v(PTE_ADDR(*pte));
+        memmove(mem, old, PTE_SZ);
+
+        *pte = 0;
+        free_page(old);
+        mappages(proc->pgdir, (char*) va, PTE_SZ, v2p(mem), AP_KU);
+        switchuvm(proc);
+
+        return 0;
+    }
+
+    ap = (v->prot & PROT_WRITE) ? AP_KU : AP_KUR;
+
+    if (v->f == 0) {
+        if ((mem = alloc_zpage()) == 0) {
+            return -1;
+        }
+
+    } else if (v->f->type == FD_SHM) {
+        if ((mem = shmpage(v->f->shm, (v->off + (va - v->start)) / PTE_SZ)) == 0) {
+            return -1;
+        }
+
+        page_dup(mem);
+
+    } else {
+        ip = v->f->ip;
+        off = v->off + (va - v->start);
+
+        ilock(ip);
+
+        // there is nothing to map past the end of the file
+        if ((off >= ip->size) || ((cp = pcache_get(ip, off / PTE_SZ)) == 0)) {
+            iunlock(ip);
+            return -1;
+        }
+
+        old = pcache_data(cp);
+
+        if ((v->flags & MAP_PRIVATE) && write) {
+            if ((mem = alloc_page()) != 0) {
+                memmove(mem, old, PTE_SZ);
+            }
+
+        } else {
+            mem = old;
+            page_dup(mem);
+
+            if (v->flags & MAP_PRIVATE) {
+                ap = AP_KUR;
+            } else {
+                // writes to the file must reach the mapping
+                pcache_share(cp);
+
+                // clean until written
+                if (!write) {
+                    ap = AP_KUR;
+                }
+            }
+        }
+
+        pcache_put(cp);
+        iunlock(ip);
+
+        if (mem == 0) {
+            return -1;
+        }
+    }
+
+    // a thread sharing the page table may have put the page in
+    // while we slept for the file
+    pte = walkpgdir(proc->pgdir, (char*) va, 0);
+
+    if (pte && (*pte & PE_TYPES)) {
+        free_page(mem);
+        return 0;
+    }
+
+    if (mappages(proc->pgdir, (char*) va, PTE_SZ, v2p(mem), ap) < 0) {
+        free_page(mem);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Put in all pages of [va, va + len), which must be mapped by the
+// current process, writable if the mapping is. System calls do this
+// for the buffers they are passed (see argptr), because the copy to
+// or from the buffer cannot take a fault: it may hold locks, even
+// the lock of the very inode that is mapped.
+int vma_prefault (uint va, uint len)
+{
+    struct vma *v;
+    pte_t *pte;
+    uint a;
+    int write;
+
+    if ((len == 0) || (va + len < va) || ((v = vma_find(proc, va)) == 0) || (va + len > v->end)) {
+        return -1;
+    }
+
+    write = v->prot & PROT_WRITE;
+
+    for (a = align_dn(va, PTE_SZ); a < va + len; a += PTE_SZ) {
+        pte = walkpgdir(proc->pgdir, (char*) a, 0);
+
+        if (pte && (*pte & PE_TYPES) && (!write || (PTE_AP(*pte) == AP_KU))) {
+            continue;
+        }
+
+        if (vma_fault(a, write) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Write back the page mem at va of shared file mapping v, as much
+// of it as lies within the file.
+static void vma_writeback (struct vma *v, uint va, char *mem)
+{
+    struct inode *ip;
+    uint off, n, i, n1, max;
+
+    ip = v->f->ip;
+    off = v->off + (va - v->start);
+
+    for (i = 0; i < PTE_SZ; i += n1) {
+        // a few blocks at a time to fit in the log, as in filewrite
+        begin_trans();
+        max = ((log_room() - 1 - 1 - 2) / 2) * 512;
+        ilock(ip);
+
+        n = (off + i < ip->size) ? ip->size - off - i : 0;
+        n1 = min(min(n, max), PTE_SZ - i);
+
+        if (n1 > 0) {
+            writei(ip, mem + i, off + i, n1);
+        }
+
+        iunlock(ip);
+        commit_trans();
+
+        if (n1 == 0) {
+            break;
+        }
+    }
+}
+
+// Remove the pages of [start, end) of mapping v from the current
+// process, writing dirty shared file pages back.
+static void vma_unmap (struct vma *v, uint start, uint end)
+{
+    pte_t *pte;
+    char *mem;
+    uint a, ap;
+
+    for (a = start; a < end; a += PTE_SZ) {
+        pte = walkpgdir(proc->pgdir, (char*) a, 0);
+
+        if (!pte || !(*pte & PE_TYPES)) {
+            continue;
+        }
+
+        mem = p2v(PTE_ADDR(*pte));
+        ap = PTE_AP(*pte);
+        *pte = 0;
+
+        if (v->f && (v->f->type == FD_INODE) && (v->flags & MAP_SHARED) && (ap == AP_KU)) {
+            vma_writeback(v, a, mem);
+        }
+
+        free_page(mem);
+    }
+
+    switchuvm(proc);
+}
+
+// Unmap [va, va + len), which must lie within one mapping. If that
+// leaves a hole in the middle, the mapping is split in two.
+int vma_unmap_range (uint va, uint len)
+{
+    struct vma *v, *nv;
+    uint end;
+
+    len = align_up(len, PTE_SZ);
+    end = va + len;
+
+    if ((va % PTE_SZ) || (len == 0) || (end < va) || ((v = vma_find(proc, va)) == 0) || (end > v->end)) {
+        return -1;
+    }
+
+    if ((va > v->start) && (end < v->end)) {
+        for (nv = proc->vmas; nv < proc->vmas + NVMA; nv++) {
+            if (nv->end == 0) {
+                break;
+            }
+        }
+
+        if (nv == proc->vmas + NVMA) {
+            return -1;
+        }
+
+        *nv = *v;
+        nv->start = end;
+        nv->off = v->off + (end - v->start);
+
+        if (nv->f) {
+            filedup(nv->f);
+        }
+
+        v->end = va;
+        vma_unmap(v, va, end);
+        return 0;
+    }
+
+    vma_unmap(v, va, end);
+
+    if (va == v->start) {
+        v->off += end - v->start;
+        v->start = end;
+    } else {
+        v->end = va;
+    }
+
+    if (v->start == v->end) {
+        if (v->f) {
+            fileclose(v->f);
+        }
+
+        v->start = v->end = 0;
+        v->f = 0;
+    }
+
+    return 0;
+}
+
+// Give np the mappings of the current process. Shared and read-only
+// pages are shared, others are copied. On failure, np is left with
+// no mappings, but may have pages in its page table.
+int vma_fork (struct proc *np)
+{
+    struct vma *v;
+    pte_t *pte;
+    char *mem, *old;
+    uint a, ap;
+
+    for (v = proc->vmas; v < proc->vmas + NVMA; v++) {
+        np->vmas[v - proc->vmas] = *v;
+
+        if (v->end == 0) {
+            continue;
+        }
+
+        if (v->f) {
+            filedup(v->f);
+        }
+
+        for (a = v->start; a < v->end; a += PTE_SZ) {
+            pte = walkpgdir(proc->pgdir, (char*) a, 0);
+
+            if (!pte || !(*pte & PE_TYPES)) {
+                // shared anonymous memory has nowhere else to come
+                // from: put the page in now to share it
+                if (v->f || !(v->flags & MAP_SHARED)) {
+                    continue;
+                }
+
+                if (vma_fault(a, 0) < 0) {
+                    goto bad;
+                }
+
+                pte = walkpgdir(proc->pgdir, (char*) a, 0);
+            }
+
+            old = p2v(PTE_ADDR(*pte));
+            ap = PTE_AP(*pte);
+
+            if ((v->flags & MAP_SHARED) || (ap == AP_KUR)) {
+                mem = old;
+                page_dup(mem);
+
+            } else if ((mem = alloc_page()) != 0) {
+                memmove(mem, old, PTE_SZ);
+
+            } else {
+                goto bad;
+            }
+
+            if (mappages(np->pgdir, (char*) a, PTE_SZ, v2p(mem), ap) < 0) {
+                free_page(mem);
+                goto bad;
+            }
+        }
+    }
+
+    return 0;
+
+bad:
+    for (v = np->vmas; v < np->vmas + NVMA; v++) {
+        if (v->f) {
+            fileclose(v->f);
+        }
+
+        v->start = v->end = 0;
+        v->f = 0;
+    }
+
+    return -1;
+}
+
+// Remove all mappings of the current process, on exit or exec.
+void vma_exit (void)
+{
+    struct vma *v;
+
+    for (v = proc->vmas; v < proc->vmas + NVMA; v++) {
+        if (v->end) {
+            vma_unmap_range(v->start, v->end - v->start);
+        }
+    }
+}
@@ -6,13 +6,21 @@
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
+#define NVMA          8  // memory mappings per process
+#define NSHM          8  // shared memory segments
+#define SHMMAXPG    256  // max pages in a shared memory segment
 #define NFILE       100  // open files per system
-#define NBUF         10  // size of disk block cache
+#define NPOLLENT    128  // poll wait queue entries per system
+#define NBUF         64  // size of disk block cache
+#define NBCLUSTER     8  // max sectors moved by one disk request
+#define NPCACHE     128  // size of file page cache
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
-#define ROOTDEV       1  // device number of file system root disk
+#define NDISK         3  // maximum block device number + 1
 #define MAXARG       32  // max exec arguments
-#define LOGSIZE      10  // max data sectors in on-disk log
+#define MAXPATH     128  // maximum file path name
+#define LOGSIZE      16  // max data sectors in on-disk log
+#define FSSIZE     1024  // default file system size in sectors (mkfs)
 
 #define HZ           10
 
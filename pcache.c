@@ -0,0 +1,277 @@
+// Page cache.
+//
+// The page cache holds whole pages of regular files and directories,
+// read through the buffer cache. readi copies file data out of it,
+// and exec maps the cached pages of read-only segments straight into
+// the new process, so a program that is run again is neither read
+// from disk nor copied. Pages are named by (dev, inum, page number)
+// and found through a hash table on the name; the LRU list is only
+// for picking a page to recycle.
+//
+// Interface:
+// * pcache_get returns the cached page, reading it in if needed;
+//     pcache_put gives it back. The caller holds the inode lock.
+// * writei calls pcache_write to keep the cached copy up to date.
+// * itrunc calls pcache_inval to drop the pages of the inode.
+//
+// A cached page may also be mapped into processes; the page's
+// reference count (page_dup) keeps it alive after the cache lets
+// go of it. A page that a shared mapping uses (pcache_share) is the
+// file's data, and writes to the file go into it. Any other mapped
+// page is never written again: a write to the file takes the page
+// out of the cache, and the processes keep the data they were
+// started with. Pages of shared mappings are recycled last, so that
+// the mappings keep seeing writes.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "fs.h"
+#include "file.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+#define NPCHASH     64      // hash buckets, a power of 2
+#define PCHASH(dev, inum, pgno)  (((inum) * 31 + (pgno) + (dev)) & (NPCHASH - 1))
+
+struct cpage {
+    uint dev;
+    uint inum;
+    uint pgno;
+    int ref;                // pcache_get without pcache_put
+    int valid;              // data holds the page
+    int shared;             // data is mapped by a shared mapping
+    char *data;             // page, 0 if none is allocated yet
+    struct cpage *prev;     // LRU list
+    struct cpage *next;
+    struct cpage *hnext;    // hash chain of the name
+};
+
+struct {
+    struct spinlock lock;
+    struct cpage page[NPCACHE];
+    struct cpage *hash[NPCHASH];
+
+    // head.next is most recently used.
+    struct cpage head;
+} pcache;
+
+void pcache_init (void)
+{
+    struct cpage *p;
+
+    initlock(&pcache.lock, "pcache");
+
+    pcache.head.prev = &pcache.head;
+    pcache.head.next = &pcache.head;
+
+    for (p = pcache.page; p < pcache.page + NPCACHE; p++) {
+        p->next = pcache.head.next;
+        p->prev = &pcache.head;
+        pcache.head.next->prev = p;
+        pcache.head.next = p;
+    }
+}
+
+// Find the valid page pgno of ip. Caller holds pcache.lock.
+static struct cpage* pcache_find (struct inode *ip, uint pgno)
+{
+    struct cpage *p;
+
+    for (p = pcache.hash[PCHASH(ip->dev, ip->inum, pgno)]; p != 0; p = p->hnext) {
+        if (p->valid && p->dev == ip->dev && p->inum == ip->inum && p->pgno == pgno) {
+            return p;
+        }
+    }
+
+    return 0;
+}
+
+// Take p off the hash chain of its name, if it is on it.
+// Caller holds pcache.lock.
+static void pcache_unhash (struct cpage *p)
+{
+    struct cpage **pp;
+
+    for (pp = &pcache.hash[PCHASH(p->dev, p->inum, p->pgno)]; *pp != 0; pp = &(*pp)->hnext) {
+        if (*pp == p) {
+            *pp = p->hnext;
+            break;
+        }
+    }
+
+    p->hnext = 0;
+}
+
+// Return the cached page pgno of the locked inode ip, reading it in
+// if it is not cached. Bytes past the end of the file are zero.
+// Returns 0 if out of memory.
+struct cpage* pcache_get (struct inode *ip, uint pgno)
+{
+    struct cpage *p, *q;
+    uint off, n;
+
+    acquire(&pcache.lock);
+
+    if ((p = pcache_find(ip, pgno)) != 0) {
+        p->ref++;
+        release(&pcache.lock);
+        return p;
+    }
+
+    // Not cached; recycle the least recently used unreferenced page,
+    // one that no shared mapping uses if there is one. Nobody else
+    // can be reading this page in, as we hold ip's lock.
+    q = 0;
+
+    for (p = pcache.head.prev; p != &pcache.head; p = p->prev) {
+        if (p->ref == 0) {
+            if (!p->shared || !p->data || !page_shared(p->data)) {
+                break;
+            }
+
+            if (q == 0) {
+                q = p;
+            }
+        }
+    }
+
+    if ((p == &pcache.head) && ((p = q) == 0)) {
+        panic("pcache_get: no pages");
+    }
+
+    pcache_unhash(p);
+
+    p->dev = ip->dev;
+    p->inum = ip->inum;
+    p->pgno = pgno;
+    p->valid = 0;
+    p->shared = 0;
+    p->ref = 1;
+
+    p->hnext = pcache.hash[PCHASH(p->dev, p->inum, p->pgno)];
+    pcache.hash[PCHASH(p->dev, p->inum, p->pgno)] = p;
+
+    release(&pcache.lock);
+
+    // a page still mapped by some process is theirs now
+    if (p->data && page_shared(p->data)) {
+        free_page(p->data);
+        p->data = 0;
+    }
+
+    if ((p->data == 0) && ((p->data = alloc_page()) == 0)) {
+        pcache_put(p);
+        return 0;
+    }
+
+    off = pgno * PTE_SZ;
+    n = 0;
+
+    if (off < ip->size) {
+        n = min(ip->size - off, PTE_SZ);
+        readblocks(ip, p->data, off, n);
+    }
+
+    memset(p->data + n, 0, PTE_SZ - n);
+
+    acquire(&pcache.lock);
+    p->valid = 1;
+    release(&pcache.lock);
+
+    return p;
+}
+
+// Release a page from pcache_get.
+void pcache_put (struct cpage *p)
+{
+    acquire(&pcache.lock);
+
+    if (p->ref <= 0) {
+        panic("pcache_put");
+    }
+
+    p->ref--;
+
+    if (p->ref == 0) {
+        // move to the head of the LRU list
+        p->next->prev = p->prev;
+        p->prev->next = p->next;
+        p->next = pcache.head.next;
+        p->prev = &pcache.head;
+        pcache.head.next->prev = p;
+        pcache.head.next = p;
+    }
+
+    release(&pcache.lock);
+}
+
+// Return the data of a page from pcache_get.
+char* pcache_data (struct cpage *p)
+{
+    return p->data;
+}
+
+// Page p from pcache_get is about to be mapped by a shared mapping.
+void pcache_share (struct cpage *p)
+{
+    acquire(&pcache.lock);
+    p->shared = 1;
+    release(&pcache.lock);
+}
+
+// Drop page p from the cache. Caller holds pcache.lock.
+static void pcache_drop (struct cpage *p)
+{
+    p->valid = 0;
+    p->shared = 0;
+
+    if (p->data && page_shared(p->data)) {
+        free_page(p->data);
+        p->data = 0;
+    }
+}
+
+// The locked inode ip has been written: copy n bytes from src (a
+// kernel address) at offset off into its cached pages.
+void pcache_write (struct inode *ip, uint off, char *src, uint n)
+{
+    struct cpage *p;
+    uint m;
+
+    acquire(&pcache.lock);
+
+    for (; n > 0; n -= m, off += m, src += m) {
+        m = min(n, PTE_SZ - off % PTE_SZ);
+
+        if ((p = pcache_find(ip, off / PTE_SZ)) == 0) {
+            continue;
+        }
+
+        if (page_shared(p->data) && !p->shared) {
+            pcache_drop(p);
+        } else {
+            memmove(p->data + off % PTE_SZ, src, m);
+        }
+    }
+
+    release(&pcache.lock);
+}
+
+// Drop all the cached pages of the locked inode ip.
+void pcache_inval (struct inode *ip)
+{
+    struct cpage *p;
+
+    acquire(&pcache.lock);
+
+    for (p = pcache.page; p < pcache.page + NPCACHE; p++) {
+        if (p->valid && p->dev == ip->dev && p->inum == ip->inum) {
+            pcache_drop(p);
+        }
+    }
+
+    release(&pcache.lock);
+}
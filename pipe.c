@@ -6,6 +6,7 @@
 #include "fs.h"
 #include "file.h"
 #include "spinlock.h"
+#include "poll.h"
 
 #define PIPESIZE 512
 
@@ -16,6 +17,7 @@ struct pipe {
     uint nwrite;    // number of bytes written
     int readopen;   // read fd is still open
     int writeopen;  // write fd is still open
+    int peeking;    // a pipepeek caller is using data in place
 };
 
 int pipealloc(struct file **f0, struct file **f1)
@@ -37,6 +39,7 @@ int pipealloc(struct file **f0, struct file **f1)
     p->writeopen = 1;
     p->nwrite = 0;
     p->nread = 0;
+    p->peeking = 0;
 
     initlock(&p->lock, "pipe");
 
@@ -75,10 +78,12 @@ void pipeclose(struct pipe *p, int writable)
     if(writable){
         p->writeopen = 0;
         wakeup(&p->nread);
+        pollwake(p);
 
     } else {
         p->readopen = 0;
         wakeup(&p->nwrite);
+        pollwake(p);
     }
 
     if(p->readopen == 0 && p->writeopen == 0){
@@ -91,56 +96,189 @@ void pipeclose(struct pipe *p, int writable)
 }
 
 //PAGEBREAK: 40
+// Copy as much as fits into the ring before it wraps at a time.
 int pipewrite(struct pipe *p, char *addr, int n)
 {
-    int i;
+    int i, m;
 
     acquire(&p->lock);
 
-    for(i = 0; i < n; i++){
+    for(i = 0; i < n; i += m){
         while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
-            if(p->readopen == 0 /*|| proc->killed*/){
+            if(p->readopen == 0 || proc->killed){
                 release(&p->lock);
                 return -1;
             }
 
             wakeup(&p->nread);
+            pollwake(p);
             sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
         }
 
-        p->data[p->nwrite++ % PIPESIZE] = addr[i];
+        m = UMIN(n - i, PIPESIZE - (p->nwrite - p->nread));
+        m = UMIN(m, PIPESIZE - p->nwrite % PIPESIZE);
+
+        if(either_copyin(&p->data[p->nwrite % PIPESIZE], addr + i, m) < 0){
+            release(&p->lock);
+            return -1;
+        }
+
+        p->nwrite += m;
     }
 
     wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+    pollwake(p);
     release(&p->lock);
     return n;
 }
 
-int piperead(struct pipe *p, char *addr, int n)
+// Whether a read of p would return without waiting: there is data,
+// or nobody is left to write any, and no pipepeek caller.
+int pipeavail(struct pipe *p)
 {
-    int i;
+    int r;
 
     acquire(&p->lock);
+    r = !p->peeking && ((p->nread != p->nwrite) || !p->writeopen);
+    release(&p->lock);
 
-    while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
+    return r;
+}
+
+// How many bytes a write to p can take without waiting. With no
+// reader left, a write fails at once, so any number can.
+uint pipespace(struct pipe *p)
+{
+    uint n;
+
+    acquire(&p->lock);
+    n = p->readopen ? PIPESIZE - (p->nwrite - p->nread) : 0xffffffff;
+    release(&p->lock);
+
+    return n;
+}
+
+// Wait until p has data, or no writer, and no pipepeek caller.
+// Caller holds p->lock.
+static int pipewait(struct pipe *p)
+{
+    while(p->peeking || (p->nread == p->nwrite && p->writeopen)){  //DOC: pipe-empty
         if(proc->killed){
-            release(&p->lock);
             return -1;
         }
 
-        sleep(&p->nread, &p->lock); //DOC: piperead-sleep*/
+        if(p->peeking){
+            sleep(&p->peeking, &p->lock);
+        } else {
+            sleep(&p->nread, &p->lock); //DOC: piperead-sleep*/
+        }
+    }
+
+    return 0;
+}
+
+int piperead(struct pipe *p, char *addr, int n)
+{
+    int i, m;
+
+    acquire(&p->lock);
+
+    if(pipewait(p) < 0){
+        release(&p->lock);
+        return -1;
     }
 
-    for(i = 0; i < n; i++){  //DOC: piperead-copy
-        if(p->nread == p->nwrite) {
-            break;
+    for(i = 0; i < n && p->nread != p->nwrite; i += m){  //DOC: piperead-copy
+        m = UMIN(n - i, p->nwrite - p->nread);
+        m = UMIN(m, PIPESIZE - p->nread % PIPESIZE);
+
+        if(either_copyout(addr + i, &p->data[p->nread % PIPESIZE], m) < 0){
+            release(&p->lock);
+            return -1;
         }
 
-        addr[i] = p->data[p->nread++ % PIPESIZE];
+        p->nread += m;
     }
 
     wakeup(&p->nwrite);  //DOC: piperead-wakeup
+    pollwake(p);
     release(&p->lock);
 
     return i;
 }
+
+// Wait for data in p and set *addr to the kernel address of the
+// first run of it that does not wrap around the ring. The data stays
+// in the pipe, so it can be copied straight to its destination; the
+// caller must then call pipeskip. Other readers wait until it does.
+// Returns the length of the run, 0 if there is no writer left, or -1.
+int pipepeek(struct pipe *p, char **addr)
+{
+    int n;
+
+    acquire(&p->lock);
+
+    if(pipewait(p) < 0){
+        release(&p->lock);
+        return -1;
+    }
+
+    n = UMIN(p->nwrite - p->nread, PIPESIZE - p->nread % PIPESIZE);
+    *addr = &p->data[p->nread % PIPESIZE];
+
+    if(n > 0){
+        p->peeking = 1;
+    }
+
+    release(&p->lock);
+    return n;
+}
+
+// Consume n bytes of the data from pipepeek.
+void pipeskip(struct pipe *p, int n)
+{
+    acquire(&p->lock);
+
+    p->nread += n;
+    p->peeking = 0;
+
+    wakeup(&p->peeking);
+    wakeup(&p->nwrite);
+    pollwake(p);
+    release(&p->lock);
+}
+
+// Return which of events the reading (or, if writing, the writing)
+// end of p is ready for, for filepoll.
+int pipepoll(struct pipe *p, int writing, int events)
+{
+    int r;
+
+    r = 0;
+
+    acquire(&p->lock);
+
+    if(writing){
+        if(!p->readopen){
+            r = POLLERR;
+        } else if(p->nwrite != p->nread + PIPESIZE){
+            r = events & POLLOUT;
+        }
+
+    } else {
+        if(!p->writeopen){
+            r = POLLHUP;
+        }
+
+        if(!p->peeking && p->nread != p->nwrite){
+            r |= events & POLLIN;
+        }
+    }
+
+    if(r == 0 && pollenter(p) < 0){
+        r = -1;
+    }
+
+    release(&p->lock);
+    return r;
+}
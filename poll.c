@@ -0,0 +1,186 @@
+// Waiting for any of several files.
+//
+// A process in poll may have to wake up for any of several pipes or
+// the console, but it can only sleep on one channel. So each object
+// it waits on gets an entry (object, process) in the poll table, the
+// object's wait queue, and the object calls pollwake when it changes.
+// pollwake sets the process's pollwoken and wakes it; the process
+// sleeps on its own proc, and only while pollwoken is clear, so a
+// change between checking the files and going to sleep is not lost.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "fs.h"
+#include "file.h"
+#include "poll.h"
+
+struct {
+    struct spinlock lock;
+    int used;                   // entries in use
+    struct {
+        void *obj;
+        struct proc *proc;
+    } ent[NPOLLENT];
+} polltable;
+
+void pollinit (void)
+{
+    initlock(&polltable.lock, "poll");
+}
+
+// Enter the current process to be woken by pollwake(obj). Returns -1
+// if the table is full. Outside poll it does nothing, so filepoll
+// can also just ask whether a file is ready.
+int pollenter (void *obj)
+{
+    int i, free;
+
+    if (!proc->polling) {
+        return 0;
+    }
+
+    free = -1;
+
+    acquire(&polltable.lock);
+
+    for (i = 0; i < NPOLLENT; i++) {
+        if (polltable.ent[i].proc == proc && polltable.ent[i].obj == obj) {
+            release(&polltable.lock);
+            return 0;
+        }
+
+        if ((polltable.ent[i].proc == 0) && (free < 0)) {
+            free = i;
+        }
+    }
+
+    if (free >= 0) {
+        polltable.ent[free].obj = obj;
+        polltable.ent[free].proc = proc;
+        polltable.used++;
+    }
+
+    release(&polltable.lock);
+    return (free >= 0) ? 0 : -1;
+}
+
+// obj has changed; wake the processes polling it.
+void pollwake (void *obj)
+{
+    struct proc *p;
+    int i;
+
+    // the common case: nobody polls anything
+    if (polltable.used == 0) {
+        return;
+    }
+
+    acquire(&polltable.lock);
+
+    for (i = 0; i < NPOLLENT; i++) {
+        if ((p = polltable.ent[i].proc) != 0 && polltable.ent[i].obj == obj) {
+            p->pollwoken = 1;
+            wakeup(p);
+        }
+    }
+
+    release(&polltable.lock);
+}
+
+// Remove the entries of the current process.
+static void polldone (void)
+{
+    int i;
+
+    acquire(&polltable.lock);
+
+    for (i = 0; i < NPOLLENT; i++) {
+        if (polltable.ent[i].proc == proc) {
+            polltable.ent[i].proc = 0;
+            polltable.ent[i].obj = 0;
+            polltable.used--;
+        }
+    }
+
+    release(&polltable.lock);
+}
+
+// Set the revents of the nfds entries of fds, entering the process
+// to be woken by the files that are not ready. Returns the number of
+// entries with events, or -1.
+static int pollscan (struct pollfd *fds, int nfds)
+{
+    struct file *f;
+    int i, n, r;
+
+    n = 0;
+
+    for (i = 0; i < nfds; i++) {
+        // a negative fd is skipped
+        if (fds[i].fd < 0) {
+            r = 0;
+
+        } else if ((fds[i].fd >= NOFILE) || ((f = proc->tg->ofile[fds[i].fd]) == 0)) {
+            r = POLLNVAL;
+
+        } else if ((r = filepoll(f, fds[i].events)) < 0) {
+            return -1;
+        }
+
+        fds[i].revents = r;
+
+        if (r != 0) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+// Wait until one of the nfds files of fds is ready for its events,
+// or for timeout ticks if timeout is not negative. Returns the number
+// of entries with events (0 on timeout), or -1.
+int poll (struct pollfd *fds, int nfds, int timeout)
+{
+    uint ticks0;
+    int n;
+
+    ticks0 = ticks;
+    proc->polling = 1;
+
+    for (;;) {
+        proc->pollwoken = 0;
+
+        if ((timeout > 0) && (pollenter(&ticks) < 0)) {
+            n = -1;
+            break;
+        }
+
+        n = pollscan(fds, nfds);
+
+        if ((n != 0) || (timeout == 0) || ((timeout > 0) && (ticks - ticks0 >= timeout))) {
+            break;
+        }
+
+        if (proc->killed) {
+            n = -1;
+            break;
+        }
+
+        acquire(&polltable.lock);
+
+        while (!proc->pollwoken && !proc->killed) {
+            sleep(proc, &polltable.lock);
+        }
+
+        release(&polltable.lock);
+    }
+
+    proc->polling = 0;
+    polldone();
+    return n;
+}
@@ -0,0 +1,12 @@
+// poll events
+#define POLLIN          0x01    // there is data to read
+#define POLLOUT         0x04    // there is room to write
+#define POLLERR         0x08    // a pipe being written has no reader
+#define POLLHUP         0x10    // a pipe being read has no writer
+#define POLLNVAL        0x20    // fd is not open
+
+struct pollfd {
+    int fd;
+    short events;               // what to wait for
+    short revents;              // what happened
+};
@@ -28,6 +28,7 @@
 struct {
     struct spinlock lock;
     struct proc proc[NPROC];
+    struct tgroup tg[NPROC];
 } ptable;
 
 static struct proc *initproc;
@@ -60,11 +61,13 @@ static struct proc* allocproc(void)
 {
     struct proc *p;
     char *sp;
+    pde_t *pgdir;
 
     acquire(&ptable.lock);
 
+    // nobody waits for a thread, so its slot is free once it exited
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
-        if(p->state == UNUSED) {
+        if(p->state == UNUSED || (p->state == ZOMBIE && p->thread)) {
             goto found;
         }
 
@@ -74,10 +77,28 @@ static struct proc* allocproc(void)
     return 0;
 
     found:
+    pgdir = 0;
+
+    if(p->state == ZOMBIE){
+        free_page(p->kstack);
+        pgdir = p->pgdir;
+    }
+
     p->state = EMBRYO;
     p->pid = nextpid++;
+    p->pgdir = 0;
+    p->thread = 0;
+    p->ctid = 0;
+    p->tg = 0;
+    memset(p->vmas, 0, sizeof(p->vmas));
+    p->killed = 0;
     release(&ptable.lock);
 
+    // the last thread of a process leaves it the page table
+    if(pgdir) {
+        freevm(pgdir);
+    }
+
     // Allocate kernel stack.
     if((p->kstack = alloc_page ()) == 0){
         p->state = UNUSED;
@@ -119,6 +140,25 @@ static struct proc* allocproc(void)
     return p;
 }
 
+// Allocate an empty thread group for a new process.
+static struct tgroup* tgalloc(void)
+{
+    struct tgroup *tg;
+
+    acquire(&ptable.lock);
+
+    for(tg = ptable.tg; tg < &ptable.tg[NPROC]; tg++) {
+        if(tg->ref == 0) {
+            tg->ref = 1;
+            release(&ptable.lock);
+            return tg;
+        }
+    }
+
+    release(&ptable.lock);
+    return 0;
+}
+
 void error_init ()
 {
     panic ("failed to craft first process\n");
@@ -135,6 +175,7 @@ void userinit(void)
 
     p = allocproc();
     initproc = p;
+    p->tg = tgalloc();
 
     if((p->pgdir = kpt_alloc()) == NULL) {
         panic("userinit: out of memory?");
@@ -157,7 +198,7 @@ void userinit(void)
     p->tf->pc = 0;					// beginning of initcode.S
 
     safestrcpy(p->name, "initcode", sizeof(p->name));
-    p->cwd = namei("/");
+    p->tg->cwd = namei("/");
 
     p->state = RUNNABLE;
 }
@@ -170,7 +211,17 @@ int growproc(int n)
 
     sz = proc->sz;
 
+    // a vfork child must leave its parent's memory alone
+    if(proc->borrowed) {
+        return -1;
+    }
+
     if(n > 0){
+        // the heap may not grow into the memory mappings
+        if(sz + n < sz || sz + n > vma_base(proc)) {
+            return -1;
+        }
+
         if((sz = allocuvm(proc->pgdir, sz, sz + n)) == 0) {
             return -1;
         }
@@ -183,6 +234,7 @@ int growproc(int n)
 
     proc->sz = sz;
     switchuvm(proc);
+    syncthreads();
 
     return 0;
 }
@@ -200,8 +252,26 @@ int fork(void)
         return -1;
     }
 
+    if((np->tg = tgalloc()) == 0){
+        free_page(np->kstack);
+        np->kstack = 0;
+        np->state = UNUSED;
+        return -1;
+    }
+
     // Copy process state from p.
     if((np->pgdir = copyuvm(proc->pgdir, proc->sz)) == 0){
+        np->tg->ref = 0;
+        free_page(np->kstack);
+        np->kstack = 0;
+        np->state = UNUSED;
+        return -1;
+    }
+
+    if(vma_fork(np) < 0){
+        freevm(np->pgdir);
+        np->pgdir = 0;
+        np->tg->ref = 0;
         free_page(np->kstack);
         np->kstack = 0;
         np->state = UNUSED;
@@ -222,12 +292,12 @@ int fork(void)
     np->tf->r0 = 0;
 
     for(i = 0; i < NOFILE; i++) {
-        if(proc->ofile[i]) {
-            np->ofile[i] = filedup(proc->ofile[i]);
+        if(proc->tg->ofile[i]) {
+            np->tg->ofile[i] = filedup(proc->tg->ofile[i]);
         }
     }
 
-    np->cwd = idup(proc->cwd);
+    np->tg->cwd = idup(proc->tg->cwd);
 
     pid = np->pid;
     np->state = RUNNABLE;
@@ -236,34 +306,375 @@ int fork(void)
     return pid;
 }
 
+// Create a process that runs on the current process's page table,
+// and suspend the current process until the child calls exec or
+// exit. Much cheaper than fork when the child is about to exec, but
+// the child must not change memory the parent still needs (it may
+// not even return from the function that called vfork).
+int vfork(void)
+{
+    int i, pid;
+    struct proc *np;
+
+    if((np = allocproc()) == 0) {
+        return -1;
+    }
+
+    if((np->tg = tgalloc()) == 0){
+        free_page(np->kstack);
+        np->kstack = 0;
+        np->state = UNUSED;
+        return -1;
+    }
+
+    np->pgdir = proc->pgdir;
+    np->sz = proc->sz;
+    np->borrowed = 1;
+    np->parent = proc;
+    *np->tf = *proc->tf;
+
+    np->base_tickets = np->parent->base_tickets;
+    np->tickets = np->base_tickets;
+    np->boost_ticks = 0;
+    np->sleep_start = 0;
+    np->sleep_duration = 0;
+
+    // Clear r0 so that vfork returns 0 in the child.
+    np->tf->r0 = 0;
+
+    for(i = 0; i < NOFILE; i++) {
+        if(proc->tg->ofile[i]) {
+            np->tg->ofile[i] = filedup(proc->tg->ofile[i]);
+        }
+    }
+
+    np->tg->cwd = idup(proc->tg->cwd);
+
+    pid = np->pid;
+    safestrcpy(np->name, proc->name, sizeof(proc->name));
+
+    acquire(&ptable.lock);
+    np->state = RUNNABLE;
+
+    while(np->borrowed) {
+        sleep(np, &ptable.lock);
+    }
+
+    release(&ptable.lock);
+
+    return pid;
+}
+
+// A vfork child gives the page table back to its parent (by exec
+// or exit), and the parent resumes. Caller holds ptable.lock.
+static void vfork_return(void)
+{
+    proc->borrowed = 0;
+    wakeup1(proc);
+}
+
+// exec has replaced the page table of a vfork child.
+void vfork_done(void)
+{
+    acquire(&ptable.lock);
+    vfork_return();
+    release(&ptable.lock);
+}
+
+// Create a process running the program at path with arguments
+// argv, without copying the current process first. The child's file
+// descriptors 0-2 are the current process's fdmap[0-2] (closed if
+// -1), or its own 0-2 if fdmap is 0; it gets no others.
+// Returns the pid of the child, or -1.
+int spawn(char *path, char **argv, int *fdmap)
+{
+    static int nomap[3] = {0, 1, 2};
+    struct uimage img;
+    struct proc *np;
+    int i, fd;
+
+    if(fdmap == 0) {
+        fdmap = nomap;
+    }
+
+    for(i = 0; i < 3; i++){
+        fd = fdmap[i];
+
+        if(fd != -1 && (fd < 0 || fd >= NOFILE)) {
+            return -1;
+        }
+    }
+
+    if((np = allocproc()) == 0) {
+        return -1;
+    }
+
+    if((np->tg = tgalloc()) == 0 || exec_load(path, argv, &img) < 0){
+        if(np->tg) {
+            np->tg->ref = 0;
+        }
+
+        free_page(np->kstack);
+        np->kstack = 0;
+        np->state = UNUSED;
+        return -1;
+    }
+
+    np->pgdir = img.pgdir;
+    np->sz = img.sz;
+    np->parent = proc;
+
+    np->base_tickets = np->parent->base_tickets;
+    np->tickets = np->base_tickets;
+    np->boost_ticks = 0;
+    np->sleep_start = 0;
+    np->sleep_duration = 0;
+
+    // start in user mode at the entry, as exec would
+    *np->tf = *proc->tf;
+    np->tf->r0 = img.argc;
+    np->tf->r1 = img.sp;
+    np->tf->pc = img.entry;
+    np->tf->sp_usr = img.sp;
+    np->tf->lr_usr = 0;
+
+    for(i = 0; i < 3; i++) {
+        if(fdmap[i] >= 0 && proc->tg->ofile[fdmap[i]]) {
+            np->tg->ofile[i] = filedup(proc->tg->ofile[fdmap[i]]);
+        }
+    }
+
+    np->tg->cwd = idup(proc->tg->cwd);
+
+    safestrcpy(np->name, img.name, sizeof(np->name));
+    np->state = RUNNABLE;
+
+    return np->pid;
+}
+
+// Create a thread of the current process. It shares the page table,
+// open files and current directory, and starts at fn(arg) on the user
+// stack at stack. If ctid is not 0, the thread's pid is stored in the
+// int there, and when the thread exits it is cleared and futex_wake'd.
+// Returns the pid of the thread, or -1.
+int clone(uint fn, uint arg, uint stack, uint ctid)
+{
+    struct proc *np;
+    int pid;
+
+    // a vfork child's memory is only on loan
+    if(proc->borrowed || (np = allocproc()) == 0) {
+        return -1;
+    }
+
+    pid = np->pid;
+
+    if(ctid && copyout(proc->pgdir, ctid, &pid, sizeof(pid)) < 0){
+        free_page(np->kstack);
+        np->kstack = 0;
+        np->state = UNUSED;
+        return -1;
+    }
+
+    np->pgdir = proc->pgdir;
+    np->sz = proc->sz;
+    memmove(np->vmas, proc->vmas, sizeof(np->vmas));
+    np->thread = 1;
+    np->ctid = (int*)ctid;
+    np->parent = proc;
+
+    np->base_tickets = proc->base_tickets;
+    np->tickets = np->base_tickets;
+    np->boost_ticks = 0;
+    np->sleep_start = 0;
+    np->sleep_duration = 0;
+
+    *np->tf = *proc->tf;
+    np->tf->r0 = arg;
+    np->tf->pc = fn;
+    np->tf->sp_usr = stack;
+    np->tf->lr_usr = 0;
+
+    safestrcpy(np->name, proc->name, sizeof(proc->name));
+
+    acquire(&ptable.lock);
+    np->tg = proc->tg;
+    np->tg->ref++;
+    np->killed = proc->killed;  // the process may be exiting
+    np->state = RUNNABLE;
+    release(&ptable.lock);
+
+    return pid;
+}
+
+// The current process has changed sz or its memory mappings; make
+// its threads see the same.
+void syncthreads(void)
+{
+    struct proc *p;
+
+    acquire(&ptable.lock);
+
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+        if(p != proc && p->tg == proc->tg && p->pgdir == proc->pgdir && p->state != ZOMBIE){
+            p->sz = proc->sz;
+            memmove(p->vmas, proc->vmas, sizeof(p->vmas));
+        }
+    }
+
+    release(&ptable.lock);
+}
+
+// Sleep until a futex_wake of user address addr, if the int there
+// still holds val; return -1 at once if it does not. The caller has
+// checked addr. Waiters are keyed by the kernel address of the int,
+// so threads, and processes sharing the page, wait on the same one.
+int futex_wait(uint addr, int val)
+{
+    int *ka;
+
+    acquire(&ptable.lock);
+
+    if((ka = (int*)uva2ka(proc->pgdir, addr)) == 0 || *ka != val || proc->killed){
+        release(&ptable.lock);
+        return -1;
+    }
+
+    sleep(ka, &ptable.lock);
+    release(&ptable.lock);
+
+    return 0;
+}
+
+// Wake up to n processes waiting on user address addr. Returns how
+// many were woken.
+int futex_wake(uint addr, int n)
+{
+    struct proc *p;
+    void *ka;
+    int woken;
+
+    woken = 0;
+
+    acquire(&ptable.lock);
+
+    if((ka = uva2ka(proc->pgdir, addr)) != 0){
+        for(p = ptable.proc; p < &ptable.proc[NPROC] && woken < n; p++){
+            if(p->state == SLEEPING && p->chan == ka){
+                p->state = RUNNABLE;
+                woken++;
+            }
+        }
+    }
+
+    release(&ptable.lock);
+    return woken;
+}
+
+// How many other threads of the current process have not exited.
+// Caller holds ptable.lock.
+static int livethreads(void)
+{
+    struct proc *p;
+    int n;
+
+    n = 0;
+
+    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+        if(p != proc && p->tg == proc->tg && p->thread
+           && p->state != UNUSED && p->state != ZOMBIE) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
 void exit(void)
 {
     struct proc *p;
-    int fd;
+    int fd, last, zero;
 
     if(proc == initproc) {
         panic("init exiting");
     }
 
-    // Close all open files.
-    for(fd = 0; fd < NOFILE; fd++){
-        if(proc->ofile[fd]){
-            fileclose(proc->ofile[fd]);
-            proc->ofile[fd] = 0;
+    // Tell a thread_join that the thread is gone.
+    if(proc->ctid){
+        zero = 0;
+
+        if(checkptr((uint)proc->ctid, sizeof(int)) == 0
+           && copyout(proc->pgdir, (uint)proc->ctid, &zero, sizeof(int)) == 0) {
+            futex_wake((uint)proc->ctid, NPROC);
         }
     }
 
-    iput(proc->cwd);
-    proc->cwd = 0;
+    acquire(&ptable.lock);
+
+    // The process takes its threads with it, and waits for them to
+    // be gone so that what they share is closed before the parent's
+    // wait() returns.
+    if(!proc->thread){
+        for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+            if(p != proc && p->tg == proc->tg && p->thread){
+                p->killed = 1;
+
+                if(p->state == SLEEPING) {
+                    p->state = RUNNABLE;
+                }
+            }
+        }
+
+        while(livethreads() > 0) {
+            sleep(proc->tg, &ptable.lock);
+        }
+    }
+
+    last = (--proc->tg->ref == 0);
+    release(&ptable.lock);
+
+    // The last thread out cleans up what they shared.
+    if(last){
+        // Unmap memory, writing back shared file mappings.
+        vma_exit();
+
+        // Close all open files.
+        for(fd = 0; fd < NOFILE; fd++){
+            if(proc->tg->ofile[fd]){
+                fileclose(proc->tg->ofile[fd]);
+                proc->tg->ofile[fd] = 0;
+            }
+        }
+
+        iput(proc->tg->cwd);
+        proc->tg->cwd = 0;
+    }
 
     acquire(&ptable.lock);
 
-    // Parent might be sleeping in wait().
+    // A vfork parent is waiting for its page table, which is not
+    // ours to free.
+    if(proc->borrowed){
+        proc->pgdir = 0;
+        vfork_return();
+    }
+
+    // The other threads still run on the page table.
+    if(!last) {
+        proc->pgdir = 0;
+    }
+
+    // Parent might be sleeping in wait(), and the main thread in
+    // exit().
     wakeup1(proc->parent);
 
+    if(proc->thread) {
+        wakeup1(proc->tg);
+    }
+
     // Pass abandoned children to init.
     for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
         if(p->parent == proc){
@@ -296,7 +707,7 @@ int wait(void)
         havekids = 0;
 
         for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-            if(p->parent != proc) {
+            if(p->parent != proc || p->thread) {
                 continue;
             }
 
@@ -307,7 +718,12 @@ int wait(void)
                 pid = p->pid;
                 free_page(p->kstack);
                 p->kstack = 0;
-                freevm(p->pgdir);
+
+                if(p->pgdir) {
+                    freevm(p->pgdir);
+                }
+
+                p->pgdir = 0;
                 p->state = UNUSED;
                 p->pid = 0;
                 p->parent = 0;
@@ -407,9 +823,11 @@ void scheduler(void)
         // }
 
         int total_tickets = 0;
+        int runnable = 0;
         for(p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
             if(p->state == RUNNABLE) {
                 total_tickets += p->tickets;
+                runnable++;
             }
         }
 
@@ -427,9 +845,21 @@ void scheduler(void)
             // Process is done running for now.
             // It should have changed its p->state before coming back.
             proc = 0;
+
+        } else if(runnable == 0 && !kmem_zero_wanted()) {
+            // Idle with nothing to do. Interrupts stay masked while
+            // ptable.lock is held, but a pending one still ends the
+            // wait and is taken once the lock is released, so a
+            // wakeup that comes after the scan above is not lost.
+            wfi();
         }
 
         release(&ptable.lock);
+
+        // Use idle time to zero free pages for allocuvm and friends.
+        if(runnable == 0) {
+            kmem_zero_idle();
+        }
     }
 }
 
@@ -50,6 +50,35 @@ struct context {
 };
 
 
+// A memory mapping (see mmap.c); unused if end is 0
+struct vma {
+    uint            start;          // first address, page aligned
+    uint            end;            // address after the last page
+    int             prot;           // PROT_READ, PROT_WRITE
+    int             flags;          // MAP_SHARED or MAP_PRIVATE
+    struct file*    f;              // mapped file, 0 if anonymous
+    uint            off;            // file offset of start
+};
+
+// A user program loaded by exec_load, not yet given to a process
+struct uimage {
+    pde_t*          pgdir;
+    uint            sz;
+    uint            entry;          // first instruction
+    uint            sp;             // user stack, argv points here too
+    uint            argc;
+    char            name[16];
+};
+
+// What the threads of a process share besides memory. Each proc
+// has its own copy of sz and the memory mappings, which syncthreads
+// keeps the same across the threads.
+struct tgroup {
+    int             ref;            // threads using it, 0 if free
+    struct file*    ofile[NOFILE];  // Open files
+    struct inode*   cwd;            // Current directory
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -64,14 +93,19 @@ struct proc {
     struct context* context;        // swtch() here to run process
     void*           chan;           // If non-zero, sleeping on chan
     int             killed;         // If non-zero, have been killed
-    struct file*    ofile[NOFILE];  // Open files
-    struct inode*   cwd;            // Current directory
+    struct tgroup*  tg;             // Open files and directory, shared by threads
     char            name[16];       // Process name (debugging)
     int             sleep_start;    // Tick count when process started sleeping
     int             sleep_duration; // Tick count when process woke up
     int             base_tickets;   // Base number of tickets for lottery scheduling
     int             tickets;        // Current number of tickets for lottery scheduling
     int             boost_ticks;     // Number of ticks the process has been boosted for
+    struct vma      vmas[NVMA];     // Memory mappings, above the heap
+    int             borrowed;       // Runs on the parent's pgdir (vfork)
+    int             thread;         // Made by clone; nobody waits for it
+    int*            ctid;           // Cleared and woken when the thread exits
+    int             polling;        // In poll, so pollenter enters it
+    int             pollwoken;      // pollwake since poll last looked
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -79,4 +113,6 @@ struct proc {
 //   original data and bss
 //   fixed-size stack
 //   expandable heap
+//   ...
+//   memory mappings, placed top-down from UADDR_SZ
 #endif
@@ -0,0 +1,115 @@
+// Shared memory segments.
+//
+// A segment is a named set of zeroed pages. shmopen returns a file
+// descriptor for the segment, creating it if there is none by that
+// name yet. mmap of the descriptor (MAP_SHARED only) maps the pages
+// themselves, so every process that opens the name, or inherits the
+// descriptor, sees the same memory. The segment goes away when the
+// last file referring to it is closed; the pages stay until the last
+// mapping of them is gone too.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "fs.h"
+#include "file.h"
+
+struct shm {
+    char name[DIRSIZ];
+    int  ref;                   // files referring to the segment
+    uint npages;
+    char *pages[SHMMAXPG];
+};
+
+struct {
+    struct spinlock lock;
+    struct shm shm[NSHM];
+} shmtable;
+
+void shminit (void)
+{
+    initlock(&shmtable.lock, "shm");
+}
+
+// Return the segment called name, with a new reference. If there is
+// none, create one of size bytes, unless size is 0. Return 0 if it
+// cannot be found or created.
+struct shm* shmget (char *name, uint size)
+{
+    struct shm *s, *free;
+    uint i;
+
+    free = 0;
+
+    acquire(&shmtable.lock);
+
+    for (s = shmtable.shm; s < shmtable.shm + NSHM; s++) {
+        if (s->ref == 0) {
+            if (free == 0) {
+                free = s;
+            }
+
+        } else if (strncmp(s->name, name, DIRSIZ) == 0) {
+            s->ref++;
+            release(&shmtable.lock);
+            return s;
+        }
+    }
+
+    if ((free == 0) || (size == 0) || (size > SHMMAXPG * PTE_SZ)) {
+        release(&shmtable.lock);
+        return 0;
+    }
+
+    s = free;
+    s->npages = align_up(size, PTE_SZ) / PTE_SZ;
+
+    for (i = 0; i < s->npages; i++) {
+        if ((s->pages[i] = alloc_zpage()) == 0) {
+            while (i-- > 0) {
+                free_page(s->pages[i]);
+            }
+
+            release(&shmtable.lock);
+            return 0;
+        }
+    }
+
+    strncpy(s->name, name, DIRSIZ);
+    s->ref = 1;
+
+    release(&shmtable.lock);
+    return s;
+}
+
+// Drop a reference to s, freeing it with the last one.
+void shmclose (struct shm *s)
+{
+    uint i;
+
+    acquire(&shmtable.lock);
+
+    if (--s->ref == 0) {
+        for (i = 0; i < s->npages; i++) {
+            free_page(s->pages[i]);
+        }
+
+        s->npages = 0;
+    }
+
+    release(&shmtable.lock);
+}
+
+// Size of s in bytes.
+uint shmsize (struct shm *s)
+{
+    return s->npages * PTE_SZ;
+}
+
+// Page pgno of s, or 0 if it is out of range.
+char* shmpage (struct shm *s, uint pgno)
+{
+    return (pgno < s->npages) ? s->pages[pgno] : 0;
+}
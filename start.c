@@ -168,10 +168,12 @@ void start (void)
 	uint32  vectbl;
     _puts("starting xv6 for ARM...\n");
 
-    // double map the low memory, required to enable paging
-    // we do not map all the physical memory
+    // double map the low memory, required to enable paging. The
+    // kernel maps all of the physical memory with 1MB sections, so
+    // its accesses to any page take one TLB entry per MB and no
+    // second-level page tables.
     set_bootpgtbl(0, 0, INIT_KERNMAP, 0);
-    set_bootpgtbl(KERNBASE, 0, INIT_KERNMAP, 0);
+    set_bootpgtbl(KERNBASE, 0, PHYSTOP, 0);
 
     // vector table is in the middle of first 1MB (0xF000)
     vectbl = P2V_WO (VEC_TBL & PDE_MASK);
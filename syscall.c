@@ -18,39 +18,32 @@ int fetchint(uint addr, int *ip)
         return -1;
     }
 
-    *ip = *(int*)(addr);
-    return 0;
+    return copyin(proc->pgdir, ip, addr, 4);
 }
 
-// Fetch the nul-terminated string at addr from the current process.
-// Doesn't actually copy the string - just sets *pp to point at it.
-// Returns length of string, not including nul.
-int fetchstr(uint addr, char **pp)
+// Copy the nul-terminated string at addr in the current process to
+// buf, which has room for max bytes. The copy is what the kernel
+// uses: another thread, or a process sharing the memory, could change
+// the string in place. Returns length of string, not including nul.
+int fetchstr(uint addr, char *buf, int max)
 {
-    char *s, *ep;
-
     if(addr >= proc->sz) {
         return -1;
     }
 
-    *pp = (char*)addr;
-    ep = (char*)proc->sz;
-
-    for(s = *pp; s < ep; s++) {
-        if(*s == 0) {
-            return s - *pp;
-        }
+    if(max > proc->sz - addr) {
+        max = proc->sz - addr;
     }
 
-    return -1;
+    return copyinstr(proc->pgdir, buf, addr, max);
 }
 
 // Fetch the nth (starting from 0) 32-bit system call argument.
-// In our ABI, r0 contains system call index, r1-r4 contain parameters.
-// now we support system calls with at most 4 parameters.
+// In our ABI, r0 contains system call index, r1-r6 contain parameters.
+// now we support system calls with at most 6 parameters.
 int argint(int n, int *ip)
 {
-    if (n > 3) {
+    if (n > 5) {
         panic ("too many system call parameters\n");
     }
 
@@ -59,18 +52,25 @@ int argint(int n, int *ip)
     return 0;
 }
 
+// Check that the size bytes at addr lie within the process address
+// space: below proc->sz, or in a memory mapping, whose pages are put
+// in now.
+int checkptr(uint addr, uint size)
+{
+    if((addr >= proc->sz || size > proc->sz - addr) && vma_prefault(addr, size) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
 // Fetch the nth word-sized system call argument as a pointer
-// to a block of memory of size n bytes.  Check that the pointer
-// lies within the process address space.
+// to a block of memory of size n bytes, and check it.
 int argptr(int n, char **pp, int size)
 {
     int i;
 
-    if(argint(n, &i) < 0) {
-        return -1;
-    }
-
-    if((uint)i >= proc->sz || (uint)i+size > proc->sz) {
+    if(argint(n, &i) < 0 || checkptr(i, size) < 0) {
         return -1;
     }
 
@@ -78,11 +78,9 @@ int argptr(int n, char **pp, int size)
     return 0;
 }
 
-// Fetch the nth word-sized system call argument as a string pointer.
-// Check that the pointer is valid and the string is nul-terminated.
-// (There is no shared writable memory, so the string can't change
-// between this check and being used by the kernel.)
-int argstr(int n, char **pp)
+// Fetch the nth word-sized system call argument as a string pointer,
+// and copy the string to buf, which has room for max bytes.
+int argstr(int n, char *buf, int max)
 {
     int addr;
 
@@ -90,7 +88,7 @@ int argstr(int n, char **pp)
         return -1;
     }
 
-    return fetchstr(addr, pp);
+    return fetchstr(addr, buf, max);
 }
 
 extern int sys_chdir(void);
@@ -116,6 +114,23 @@ extern int sys_write(void);
 extern int sys_uptime(void);
 extern int sys_settickets(void);
 extern int sys_getpinfo(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_shmopen(void);
+extern int sys_spawn(void);
+extern int sys_vfork(void);
+extern int sys_readv(void);
+extern int sys_writev(void);
+extern int sys_pread(void);
+extern int sys_pwrite(void);
+extern int sys_splice(void);
+extern int sys_ring_enter(void);
+extern int sys_pipe2(void);
+extern int sys_poll(void);
+extern int sys_clone(void);
+extern int sys_futex_wait(void);
+extern int sys_futex_wake(void);
+extern int sys_readdirplus(void);
 
 static int (*syscalls[])(void) = {
         [SYS_fork]    sys_fork,
@@ -141,6 +156,23 @@ static int (*syscalls[])(void) = {
         [SYS_close]   sys_close,
         [SYS_settickets] sys_settickets,
         [SYS_getpinfo]   sys_getpinfo,
+        [SYS_mmap]       sys_mmap,
+        [SYS_munmap]     sys_munmap,
+        [SYS_shmopen]    sys_shmopen,
+        [SYS_spawn]      sys_spawn,
+        [SYS_vfork]      sys_vfork,
+        [SYS_readv]      sys_readv,
+        [SYS_writev]     sys_writev,
+        [SYS_pread]      sys_pread,
+        [SYS_pwrite]     sys_pwrite,
+        [SYS_splice]     sys_splice,
+        [SYS_ring_enter] sys_ring_enter,
+        [SYS_pipe2]      sys_pipe2,
+        [SYS_poll]       sys_poll,
+        [SYS_clone]      sys_clone,
+        [SYS_futex_wait] sys_futex_wait,
+        [SYS_futex_wake] sys_futex_wake,
+        [SYS_readdirplus] sys_readdirplus,
 };
 
 void syscall(void)
@@ -22,3 +22,20 @@
 #define SYS_close  21
 #define SYS_settickets 22
 #define SYS_getpinfo   23
+#define SYS_mmap       24
+#define SYS_munmap     25
+#define SYS_shmopen    26
+#define SYS_spawn      27
+#define SYS_vfork      28
+#define SYS_readv      29
+#define SYS_writev     30
+#define SYS_pread      31
+#define SYS_pwrite     32
+#define SYS_splice     33
+#define SYS_ring_enter 34
+#define SYS_pipe2      35
+#define SYS_poll       36
+#define SYS_clone      37
+#define SYS_futex_wait 38
+#define SYS_futex_wake 39
+#define SYS_readdirplus 40
@@ -13,9 +13,16 @@
 #include "fs.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
+#include "uio.h"
+#include "ioring.h"
+#include "poll.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// The threads of a process share its descriptors, so the caller gets
+// a reference to the file, which it gives back with fileclose, and a
+// close() in another thread cannot free the file while it is in use.
 static int argfd(int n, int *pfd, struct file **pf)
 {
     int fd;
@@ -25,7 +32,7 @@ static int argfd(int n, int *pfd, struct file **pf)
         return -1;
     }
 
-    if(fd < 0 || fd >= NOFILE || (f=proc->ofile[fd]) == 0) {
+    if(fd < 0 || fd >= NOFILE || (f=proc->tg->ofile[fd]) == 0) {
         return -1;
     }
 
@@ -34,7 +41,7 @@ static int argfd(int n, int *pfd, struct file **pf)
     }
 
     if(pf) {
-        *pf = f;
+        *pf = filedup(f);
     }
 
     return 0;
@@ -47,8 +54,8 @@ static int fdalloc(struct file *f)
     int fd;
 
     for(fd = 0; fd < NOFILE; fd++){
-        if(proc->ofile[fd] == 0){
-            proc->ofile[fd] = f;
+        if(proc->tg->ofile[fd] == 0){
+            proc->tg->ofile[fd] = f;
             return fd;
         }
     }
@@ -65,12 +72,12 @@ int sys_dup(void)
         return -1;
     }
 
+    // the new descriptor takes over our reference
     if((fd=fdalloc(f)) < 0) {
+        fileclose(f);
         return -1;
     }
 
-    filedup(f);
-
     return fd;
 }
 
@@ -80,11 +87,14 @@ int sys_read(void)
     int n;
     char *p;
 
-    if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0) {
+    if(argint(2, &n) < 0 || argptr(1, &p, n) < 0 || argfd(0, 0, &f) < 0) {
         return -1;
     }
 
-    return fileread(f, p, n);
+    n = fileread(f, p, n);
+    fileclose(f);
+
+    return n;
 }
 
 int sys_write(void)
@@ -93,11 +103,136 @@ int sys_write(void)
     int n;
     char *p;
 
-    if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0) {
+    if(argint(2, &n) < 0 || argptr(1, &p, n) < 0 || argfd(0, 0, &f) < 0) {
+        return -1;
+    }
+
+    n = filewrite(f, p, n);
+    fileclose(f);
+
+    return n;
+}
+
+// Fetch the nth system call argument as an array of cnt iovecs into
+// iov, and check the buffers they point to.
+static int argiov(int n, int cnt, struct iovec *iov)
+{
+    char *p;
+    uint total;
+    int i;
+
+    if(cnt <= 0 || cnt > IOV_MAX || argptr(n, &p, cnt * sizeof(*iov)) < 0) {
+        return -1;
+    }
+
+    // copy them, so they cannot change while in use
+    memmove(iov, p, cnt * sizeof(*iov));
+    total = 0;
+
+    for(i = 0; i < cnt; i++) {
+        if(checkptr((uint)iov[i].iov_base, iov[i].iov_len) < 0) {
+            return -1;
+        }
+
+        // the byte count must fit the return value
+        if((total += iov[i].iov_len) > 0x7fffffff) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int sys_readv(void)
+{
+    struct file *f;
+    struct iovec iov[IOV_MAX];
+    int cnt;
+
+    if(argint(2, &cnt) < 0 || argiov(1, cnt, iov) < 0 || argfd(0, 0, &f) < 0) {
+        return -1;
+    }
+
+    cnt = filereadv(f, iov, cnt, -1);
+    fileclose(f);
+
+    return cnt;
+}
+
+int sys_writev(void)
+{
+    struct file *f;
+    struct iovec iov[IOV_MAX];
+    int cnt;
+
+    if(argint(2, &cnt) < 0 || argiov(1, cnt, iov) < 0 || argfd(0, 0, &f) < 0) {
+        return -1;
+    }
+
+    cnt = filewritev(f, iov, cnt, -1);
+    fileclose(f);
+
+    return cnt;
+}
+
+// Move up to n bytes from fdin to fdout inside the kernel.
+int sys_splice(void)
+{
+    struct file *in, *out;
+    int n;
+
+    if(argint(2, &n) < 0 || argfd(0, 0, &in) < 0) {
+        return -1;
+    }
+
+    if(argfd(1, 0, &out) < 0){
+        fileclose(in);
+        return -1;
+    }
+
+    n = filesplice(in, out, n);
+    fileclose(in);
+    fileclose(out);
+
+    return n;
+}
+
+// Read at offset off, leaving the file offset alone.
+int sys_pread(void)
+{
+    struct file *f;
+    struct iovec iov;
+    int n, off;
+
+    if(argint(2, &n) < 0 || argptr(1, (char**)&iov.iov_base, n) < 0
+       || argint(3, &off) < 0 || off < 0 || argfd(0, 0, &f) < 0) {
+        return -1;
+    }
+
+    iov.iov_len = n;
+    n = filereadv(f, &iov, 1, off);
+    fileclose(f);
+
+    return n;
+}
+
+// Write at offset off, leaving the file offset alone.
+int sys_pwrite(void)
+{
+    struct file *f;
+    struct iovec iov;
+    int n, off;
+
+    if(argint(2, &n) < 0 || argptr(1, (char**)&iov.iov_base, n) < 0
+       || argint(3, &off) < 0 || off < 0 || argfd(0, 0, &f) < 0) {
         return -1;
     }
 
-    return filewrite(f, p, n);
+    iov.iov_len = n;
+    n = filewritev(f, &iov, 1, off);
+    fileclose(f);
+
+    return n;
 }
 
 int sys_close(void)
@@ -109,7 +244,9 @@ int sys_close(void)
         return -1;
     }
 
-    proc->ofile[fd] = 0;
+    // drop the descriptor's reference, then ours
+    proc->tg->ofile[fd] = 0;
+    fileclose(f);
     fileclose(f);
 
     return 0;
@@ -120,20 +257,43 @@ int sys_fstat(void)
     struct file *f;
     struct stat *st;
 
-    if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0) {
+    int r;
+
+    if(argptr(1, (void*)&st, sizeof(*st)) < 0 || argfd(0, 0, &f) < 0) {
         return -1;
     }
 
-    return filestat(f, st);
+    r = filestat(f, st);
+    fileclose(f);
+
+    return r;
+}
+
+// Read up to n directory entries, with their inodes' type and size.
+int sys_readdirplus(void)
+{
+    struct file *f;
+    struct direntplus *dst;
+    int n;
+
+    if(argint(2, &n) < 0 || n < 0 || n > 0x7fffffff / sizeof(*dst)
+       || argptr(1, (void*)&dst, n * sizeof(*dst)) < 0 || argfd(0, 0, &f) < 0) {
+        return -1;
+    }
+
+    n = filereaddir(f, dst, n);
+    fileclose(f);
+
+    return n;
 }
 
 // Create the path new as a link to the same inode as old.
 int sys_link(void)
 {
-    char name[DIRSIZ], *new, *old;
+    char name[DIRSIZ], new[MAXPATH], old[MAXPATH];
     struct inode *dp, *ip;
 
-    if(argstr(0, &old) < 0 || argstr(1, &new) < 0) {
+    if(argstr(0, old, sizeof(old)) < 0 || argstr(1, new, sizeof(new)) < 0) {
         return -1;
     }
 
@@ -188,12 +348,15 @@ static int isdirempty(struct inode *dp)
     int off;
     struct dirent de;
 
-    for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
+    // a hashed directory has "." and ".." in its leaves, not first
+    off = dirhashed(dp) ? BSIZE : 2*sizeof(de);
+
+    for(; off<dp->size; off+=sizeof(de)){
         if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de)) {
             panic("isdirempty: readi");
         }
 
-        if(de.inum != 0) {
+        if(de.inum != 0 && namecmp(de.name, ".") != 0 && namecmp(de.name, "..") != 0) {
             return 0;
         }
     }
@@ -205,10 +368,10 @@ int sys_unlink(void)
 {
     struct inode *ip, *dp;
     struct dirent de;
-    char name[DIRSIZ], *path;
+    char name[DIRSIZ], path[MAXPATH];
     uint off;
 
-    if(argstr(0, &path) < 0) {
+    if(argstr(0, path, sizeof(path)) < 0) {
         return -1;
     }
 
@@ -312,8 +475,18 @@ static struct inode* create(char *path, short type, short major, short minor)
         }
     }
 
+    // dp may be full
     if(dirlink(dp, name, ip->inum) < 0) {
-        panic("create: dirlink");
+        if(type == T_DIR){
+            dp->nlink--;
+            iupdate(dp);
+        }
+
+        ip->nlink = 0;
+        iupdate(ip);
+        iunlockput(ip);
+        iunlockput(dp);
+        return 0;
     }
 
     iunlockput(dp);
@@ -321,20 +494,17 @@ static struct inode* create(char *path, short type, short major, short minor)
     return ip;
 }
 
-int sys_open(void)
+// Open path with omode and return the new file descriptor.
+static int openpath(char *path, int omode)
 {
-    char *path;
-    int fd, omode;
+    int fd;
     struct file *f;
     struct inode *ip;
 
-    if(argstr(0, &path) < 0 || argint(1, &omode) < 0) {
-        return -1;
-    }
-
     if(omode & O_CREATE){
+        // a new file keeps its data in its inode until it grows
         begin_trans();
-        ip = create(path, T_FILE, 0, 0);
+        ip = create(path, T_FILE, DINLINE, 0);
         commit_trans();
 
         if(ip == 0) {
@@ -348,7 +518,7 @@ int sys_open(void)
 
         ilock(ip);
 
-        if(ip->type == T_DIR && omode != O_RDONLY){
+        if(ip->type == T_DIR && (omode & (O_WRONLY | O_RDWR))){
             iunlockput(ip);
             return -1;
         }
@@ -370,18 +540,31 @@ int sys_open(void)
     f->off = 0;
     f->readable = !(omode & O_WRONLY);
     f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+    f->nonblock = (omode & O_NONBLOCK) != 0;
 
     return fd;
 }
 
+int sys_open(void)
+{
+    char path[MAXPATH];
+    int omode;
+
+    if(argstr(0, path, sizeof(path)) < 0 || argint(1, &omode) < 0) {
+        return -1;
+    }
+
+    return openpath(path, omode);
+}
+
 int sys_mkdir(void)
 {
-    char *path;
+    char path[MAXPATH];
     struct inode *ip;
 
     begin_trans();
 
-    if(argstr(0, &path) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+    if(argstr(0, path, sizeof(path)) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
         commit_trans();
         return -1;
     }
@@ -395,13 +578,13 @@ int sys_mkdir(void)
 int sys_mknod(void)
 {
     struct inode *ip;
-    char *path;
+    char path[MAXPATH];
     int len;
     int major, minor;
 
     begin_trans();
 
-    if((len=argstr(0, &path)) < 0 ||
+    if((len=argstr(0, path, sizeof(path))) < 0 ||
             argint(1, &major) < 0 || argint(2, &minor) < 0 ||
             (ip = create(path, T_DEV, major, minor)) == 0){
 
@@ -417,10 +600,10 @@ int sys_mknod(void)
 
 int sys_chdir(void)
 {
-    char *path;
+    char path[MAXPATH];
     struct inode *ip;
 
-    if(argstr(0, &path) < 0 || (ip = namei(path)) == 0) {
+    if(argstr(0, path, sizeof(path)) < 0 || (ip = namei(path)) == 0) {
         return -1;
     }
 
@@ -433,26 +616,32 @@ int sys_chdir(void)
 
     iunlock(ip);
 
-    iput(proc->cwd);
-    proc->cwd = ip;
+    iput(proc->tg->cwd);
+    proc->tg->cwd = ip;
 
     return 0;
 }
 
-int sys_exec(void)
+// Copy the path (system call argument 0) and the argv array
+// (argument 1) of exec or spawn into the page buf. path is at the
+// start of buf; argv points into it.
+static int fetchexec(char *buf, char **argv)
 {
-    char *path, *argv[MAXARG];
-    int i;
-    uint uargv, uarg;
+    int i, n, off;
+    uint upath, uargv, uarg;
+
+    if(argint(0, (int*)&upath) < 0 || argint(1, (int*)&uargv) < 0){
+        return -1;
+    }
 
-    if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
+    if((n = copyinstr(proc->pgdir, buf, upath, PTE_SZ)) < 0){
         return -1;
     }
 
-    memset(argv, 0, sizeof(argv));
+    off = n + 1;
 
     for(i=0;; i++){
-        if(i >= NELEM(argv)) {
+        if(i >= MAXARG) {
             return -1;
         }
 
@@ -465,24 +654,70 @@ int sys_exec(void)
             break;
         }
 
-        if(fetchstr(uarg, &argv[i]) < 0) {
+        argv[i] = buf + off;
+
+        if((n = copyinstr(proc->pgdir, argv[i], uarg, PTE_SZ - off)) < 0) {
             return -1;
         }
+
+        off += n + 1;
     }
 
-    return exec(path, argv);
+    return 0;
 }
 
-int sys_pipe(void)
+int sys_exec(void)
 {
-    int *fd;
-    struct file *rf, *wf;
-    int fd0, fd1;
+    char *argv[MAXARG], *buf;
+    int r;
 
-    if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0) {
+    if((buf = alloc_page()) == 0){
+        return -1;
+    }
+
+    r = -1;
+
+    if(fetchexec(buf, argv) == 0) {
+        r = exec(buf, argv);
+    }
+
+    free_page(buf);
+    return r;
+}
+
+int sys_spawn(void)
+{
+    char *argv[MAXARG], *buf;
+    int *fdmap, r;
+
+    if(argint(2, (int*)&fdmap) < 0) {
+        return -1;
+    }
+
+    if(fdmap && argptr(2, (char**)&fdmap, 3*sizeof(int)) < 0) {
         return -1;
     }
 
+    if((buf = alloc_page()) == 0){
+        return -1;
+    }
+
+    r = -1;
+
+    if(fetchexec(buf, argv) == 0) {
+        r = spawn(buf, argv, fdmap);
+    }
+
+    free_page(buf);
+    return r;
+}
+
+// Make a pipe into fd[0] and fd[1]; flags may have O_NONBLOCK.
+static int makepipe(int *fd, int flags)
+{
+    struct file *rf, *wf;
+    int fd0, fd1;
+
     if(pipealloc(&rf, &wf) < 0) {
         return -1;
     }
@@ -491,7 +726,7 @@ int sys_pipe(void)
 
     if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
         if(fd0 >= 0) {
-            proc->ofile[fd0] = 0;
+            proc->tg->ofile[fd0] = 0;
         }
 
         fileclose(rf);
@@ -500,8 +735,246 @@ int sys_pipe(void)
         return -1;
     }
 
+    rf->nonblock = wf->nonblock = (flags & O_NONBLOCK) != 0;
+
     fd[0] = fd0;
     fd[1] = fd1;
 
     return 0;
 }
+
+int sys_pipe(void)
+{
+    int *fd;
+
+    if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0) {
+        return -1;
+    }
+
+    return makepipe(fd, 0);
+}
+
+int sys_pipe2(void)
+{
+    int *fd, flags;
+
+    if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0 || argint(1, &flags) < 0) {
+        return -1;
+    }
+
+    return makepipe(fd, flags);
+}
+
+// Wait for any of nfds files to be ready; see poll.c.
+int sys_poll(void)
+{
+    struct pollfd *fds;
+    int nfds, timeout;
+
+    if(argint(1, &nfds) < 0 || nfds < 0 || nfds > NOFILE
+       || argptr(0, (void*)&fds, nfds * sizeof(*fds)) < 0 || argint(2, &timeout) < 0) {
+        return -1;
+    }
+
+    return poll(fds, nfds, timeout);
+}
+
+int sys_mmap(void)
+{
+    struct file *f;
+    int addr, len, prot, flags, off;
+
+    // addr is only a hint, and we do not take hints
+    if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0
+       || argint(3, &flags) < 0 || argint(5, &off) < 0) {
+        return -1;
+    }
+
+    f = 0;
+
+    if(!(flags & MAP_ANONYMOUS) && argfd(4, 0, &f) < 0) {
+        return -1;
+    }
+
+    if((addr = vma_map(len, prot, flags, f, off)) != -1) {
+        syncthreads();
+    }
+
+    if(f) {
+        fileclose(f);
+    }
+
+    return addr;
+}
+
+int sys_munmap(void)
+{
+    int addr, len;
+
+    if(argint(0, &addr) < 0 || argint(1, &len) < 0) {
+        return -1;
+    }
+
+    if(vma_unmap_range(addr, len) < 0) {
+        return -1;
+    }
+
+    syncthreads();
+    return 0;
+}
+
+// Open the shared memory segment called name, creating it with
+// size bytes if it does not exist and size is not 0.
+int sys_shmopen(void)
+{
+    char name[MAXPATH];
+    int fd, size;
+    struct file *f;
+    struct shm *s;
+
+    if(argstr(0, name, sizeof(name)) < 0 || argint(1, &size) < 0 || size < 0) {
+        return -1;
+    }
+
+    if((s = shmget(name, size)) == 0) {
+        return -1;
+    }
+
+    if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
+        if(f) {
+            fileclose(f);
+        }
+
+        shmclose(s);
+        return -1;
+    }
+
+    f->type = FD_SHM;
+    f->shm = s;
+    f->off = 0;
+    f->readable = 1;
+    f->writable = 1;
+
+    return fd;
+}
+
+// Do the operation of submission entry e, for ring_enter.
+static int ringop(struct iosqe *e)
+{
+    struct file *f;
+    struct iovec iov;
+    char path[MAXPATH];
+    int n;
+
+    if(e->op == IO_NOP) {
+        return 0;
+    }
+
+    if(e->op == IO_OPEN) {
+        if(fetchstr((uint)e->addr, path, sizeof(path)) < 0) {
+            return -1;
+        }
+
+        return openpath(path, e->len);
+    }
+
+    if(e->fd < 0 || e->fd >= NOFILE || (f = proc->tg->ofile[e->fd]) == 0) {
+        return -1;
+    }
+
+    if(e->op == IO_CLOSE) {
+        proc->tg->ofile[e->fd] = 0;
+        fileclose(f);
+        return 0;
+    }
+
+    if(e->op != IO_READ && e->op != IO_WRITE) {
+        return -1;
+    }
+
+    if(e->len > 0x7fffffff || checkptr((uint)e->addr, e->len) < 0) {
+        return -1;
+    }
+
+    iov.iov_base = e->addr;
+    iov.iov_len = e->len;
+
+    // hold the file, as argfd does
+    filedup(f);
+
+    if(e->op == IO_READ) {
+        n = filereadv(f, &iov, 1, e->off);
+    } else {
+        n = filewritev(f, &iov, 1, e->off);
+    }
+
+    fileclose(f);
+    return n;
+}
+
+// Whether entry e would wait for a pipe.
+static int ringwaits(struct iosqe *e)
+{
+    struct file *f;
+
+    if(e->fd < 0 || e->fd >= NOFILE || (f = proc->tg->ofile[e->fd]) == 0 || f->type != FD_PIPE) {
+        return 0;
+    }
+
+    if(e->op == IO_READ) {
+        return !pipeavail(f->pipe);
+    }
+
+    if(e->op == IO_WRITE) {
+        return pipespace(f->pipe) < e->len;
+    }
+
+    return 0;
+}
+
+// Do the submitted entries of the ring at the first argument, in
+// order, while there is room for their completions. With
+// IORING_NOWAIT, stop at an entry that would wait for a pipe; it
+// stays queued. Returns the number of entries done.
+int sys_ring_enter(void)
+{
+    struct ioring *r;
+    struct iosqe e;
+    struct iocqe *c;
+    uint size;
+    int flags, n;
+
+    if(argptr(0, (char**)&r, sizeof(*r)) < 0 || argint(1, &flags) < 0) {
+        return -1;
+    }
+
+    // the program can change size; use the one that was checked
+    size = r->size;
+
+    if(size == 0 || size > IORING_MAX || (size & (size - 1))
+       || checkptr((uint)r, IORING_SZ(size)) < 0) {
+        return -1;
+    }
+
+    for(n = 0; r->sqhead != r->sqtail && r->cqtail - r->cqhead < size; n++) {
+        if(proc->killed) {
+            break;
+        }
+
+        e = r->sq[r->sqhead & (size - 1)];
+
+        if((flags & IORING_NOWAIT) && ringwaits(&e)) {
+            break;
+        }
+
+        r->sqhead++;
+
+        c = (struct iocqe*)(r->sq + size) + (r->cqtail & (size - 1));
+        c->res = ringop(&e);
+        c->data = e.data;
+
+        r->cqtail++;
+    }
+
+    return n;
+}
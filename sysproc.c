@@ -12,6 +12,51 @@ int sys_fork(void)
     return fork();
 }
 
+int sys_vfork(void)
+{
+    return vfork();
+}
+
+int sys_clone(void)
+{
+    int fn, arg, stack, ctid;
+    char *p;
+
+    if(argint(0, &fn) < 0 || argint(1, &arg) < 0 || argint(2, &stack) < 0 || argint(3, &ctid) < 0) {
+        return -1;
+    }
+
+    if(ctid && argptr(3, &p, sizeof(int)) < 0) {
+        return -1;
+    }
+
+    return clone(fn, arg, stack, ctid);
+}
+
+int sys_futex_wait(void)
+{
+    char *addr;
+    int val;
+
+    if(argptr(0, &addr, sizeof(int)) < 0 || argint(1, &val) < 0 || ((uint)addr & 3)) {
+        return -1;
+    }
+
+    return futex_wait((uint)addr, val);
+}
+
+int sys_futex_wake(void)
+{
+    char *addr;
+    int n;
+
+    if(argptr(0, &addr, sizeof(int)) < 0 || argint(1, &n) < 0 || ((uint)addr & 3)) {
+        return -1;
+    }
+
+    return futex_wake((uint)addr, n);
+}
+
 int sys_exit(void)
 {
     exit();
@@ -66,6 +111,12 @@ int sys_sleep(void)
         return -1;
     }
 
+    // sleep(0) gives up the rest of the time slice
+    if(n <= 0) {
+        yield();
+        return 0;
+    }
+
     acquire(&tickslock);
 
     ticks0 = ticks;
@@ -13,10 +13,10 @@
 
 #define static_assertion(a, b) do { switch (0) case 0: case (a): ; } while (0)
 
-int nblocks = 985;
+int nblocks;
 int nlog = LOGSIZE;
 int ninodes = 200;
-int size = 1024;
+int size = FSSIZE;
 
 int fsfd;
 struct superblock sb;
@@ -26,6 +26,11 @@ uint usedblocks;
 uint bitblocks;
 uint freeinode = 1;
 
+// The root directory's entries, written out once all are known.
+#define NROOT 1024
+struct dirent root[NROOT];
+int nroot;
+
 void balloc(int);
 void wsect(uint, void*);
 void winode(uint, struct dinode*);
@@ -33,6 +38,8 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void rootlink(ushort inum, char *name);
+void writeroot(uint rootino);
 
 // convert to intel byte order
 ushort
@@ -61,16 +68,20 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  uint rootino, inum;
   char buf[512];
-  struct dinode din;
 
 
   static_assertion(sizeof(int) == 4, "Integers must be 4 bytes!");
 
-  if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+  if(argc > 3 && strcmp(argv[1], "-s") == 0){
+    size = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+
+  if(argc < 2 || size < 64){
+    fprintf(stderr, "Usage: mkfs [-s blocks] fs.img files...\n");
     exit(1);
   }
 
@@ -83,15 +94,16 @@ main(int argc, char *argv[])
     exit(1);
   }
 
+  bitblocks = size/(512*8) + 1;
+  usedblocks = ninodes / IPB + 3 + bitblocks;
+  freeblock = usedblocks;
+  nblocks = size - usedblocks - nlog;
+
   sb.size = xint(size);
   sb.nblocks = xint(nblocks); // so whole disk is size sectors
   sb.ninodes = xint(ninodes);
   sb.nlog = xint(nlog);
 
-  bitblocks = size/(512*8) + 1;
-  usedblocks = ninodes / IPB + 3 + bitblocks;
-  freeblock = usedblocks;
-
   printf("used %d (bit %d ninode %zu) free %u log %u total %d\n", usedblocks,
          bitblocks, ninodes/IPB + 1, freeblock, nlog, nblocks+usedblocks+nlog);
 
@@ -107,15 +119,8 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  rootlink(rootino, ".");
+  rootlink(rootino, "..");
 
   for(i = 2; i < argc; i++){
     assert(index(argv[i], '/') == 0);
@@ -134,10 +139,7 @@ main(int argc, char *argv[])
 
     inum = ialloc(T_FILE);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, argv[i], DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    rootlink(inum, argv[i]);
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -145,12 +147,7 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  writeroot(rootino);
 
   balloc(usedblocks);
 
@@ -230,6 +227,67 @@ ialloc(ushort type)
   return inum;
 }
 
+void
+rootlink(ushort inum, char *name)
+{
+  assert(nroot < NROOT);
+  bzero(&root[nroot], sizeof(root[nroot]));
+  root[nroot].inum = xshort(inum);
+  strncpy(root[nroot].name, name, DIRSIZ);
+  nroot++;
+}
+
+// Write the root directory: one block of dirents if they fit, else
+// hashed like the kernel does it (see struct dirindex in fs.h), with
+// as many leaves as it takes to fit each leaf's entries in a block.
+void
+writeroot(uint rootino)
+{
+  struct dirindex di;
+  struct dirent leaf[DPB];
+  uint mask, slot;
+  int i, j, n, depth, full;
+
+  if(nroot <= DPB){
+    bzero(leaf, sizeof(leaf));
+    memmove(leaf, root, nroot * sizeof(struct dirent));
+    iappend(rootino, leaf, sizeof(leaf));
+    return;
+  }
+
+  for(depth = 1; depth <= DIRMAXDEPTH; depth++){
+    mask = (1 << depth) - 1;
+    full = 0;
+    for(slot = 0; slot <= mask && !full; slot++){
+      for(i = n = 0; i < nroot; i++)
+        if((dirhash(root[i].name) & mask) == slot)
+          n++;
+      full = n > DPB;
+    }
+    if(!full)
+      break;
+  }
+  assert(depth <= DIRMAXDEPTH);
+
+  bzero(&di, sizeof(di));
+  di.depth = xshort(depth);
+  for(slot = 0; slot <= mask; slot++){
+    di.leaf[slot] = xshort(slot + 1);
+    di.ldepth[slot] = depth;
+  }
+  bzero(leaf, sizeof(leaf));
+  memmove(leaf, &di, sizeof(di));
+  iappend(rootino, leaf, BSIZE);
+
+  for(slot = 0; slot <= mask; slot++){
+    bzero(leaf, sizeof(leaf));
+    for(i = j = 0; i < nroot; i++)
+      if((dirhash(root[i].name) & mask) == slot)
+        leaf[j++] = root[i];
+    iappend(rootino, leaf, sizeof(leaf));
+  }
+}
+
 void
 balloc(int used)
 {
@@ -5,11 +5,17 @@
 #include "arm.h"
 #include "proc.h"
 
+#define DFSR_WNR    (1 << 11)   // the abort was caused by a write
+
 // trap routine
 void swi_handler (struct trapframe *r)
 {
     proc->tf = r;
     syscall ();
+
+    if (proc->killed) {
+        exit();
+    }
 }
 
 // trap routine
@@ -25,6 +31,11 @@ void irq_handler (struct trapframe *r)
     if (proc && proc->state == RUNNING) {
         yield();
     }
+
+    // a killed process goes on its way back to user mode
+    if (proc && proc->killed && (r->spsr & MODE_MASK) == USR_MODE) {
+        exit();
+    }
 }
 
 // trap routine
@@ -46,18 +57,33 @@ void dabort_handler (struct trapframe *r)
 {
     uint dfs, fa;
 
-    cli();
-
     // read data fault status register
     asm("MRC p15, 0, %[r], c5, c0, 0": [r]"=r" (dfs)::);
 
     // read the fault address register
     asm("MRC p15, 0, %[r], c6, c0, 0": [r]"=r" (fa)::);
-    
+
+    // a user page fault: put in the page of a memory mapping, or
+    // kill the process
+    if ((r->spsr & MODE_MASK) == USR_MODE) {
+        proc->tf = r;
+
+        if (vma_fault(fa, dfs & DFSR_WNR) == 0) {
+            return;
+        }
+
+        cprintf ("pid %d %s: data abort at 0x%x, fault addr 0x%x, reason 0x%x -- kill proc\n",
+                 proc->pid, proc->name, r->pc, fa, dfs);
+        exit();
+    }
+
+    cli();
+
     cprintf ("data abort: instruction 0x%x, fault addr 0x%x, reason 0x%x \n",
              r->pc, fa, dfs);
     
     dump_trapframe (r);
+    panic ("kernel data abort");
 }
 
 // trap routine
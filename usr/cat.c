@@ -2,13 +2,19 @@
 #include "stat.h"
 #include "user.h"
 
-char buf[512];
+uint buf[8192];                 // 32 KB, word aligned
 
 void
 cat(int fd)
 {
     int n;
     
+    // let the kernel move the data when it can (a file or a pipe)
+    while((n = splice(fd, 1, sizeof(buf))) > 0)
+        ;
+    if(n == 0)
+        return;
+
     while((n = read(fd, buf, sizeof(buf))) > 0)
         write(1, buf, n);
     if(n < 0){
@@ -0,0 +1,88 @@
+// Coroutine benchmark. Passes a value back and forth between two
+// coroutines over channels, and between two processes over pipes,
+// then starts many coroutines and many processes.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "coro.h"
+
+#define ROUNDS  2000
+#define TASKS   500
+
+struct chan *ping, *pong;
+
+void
+pinger(void *arg)
+{
+    int i, v;
+
+    for(i = 0; i < ROUNDS; i++){
+        chan_send(ping, i);
+        chan_recv(pong, &v);
+    }
+    chan_close(ping);
+}
+
+void
+ponger(void *arg)
+{
+    int v;
+
+    while(chan_recv(ping, &v))
+        chan_send(pong, v);
+}
+
+void
+nothing(void *arg)
+{
+    co_yield();
+}
+
+int
+main(int argc, char *argv[])
+{
+    int a[2], b[2], i, v, start;
+
+    ping = chan_new(0);
+    pong = chan_new(0);
+    start = uptime();
+    co_spawn(pinger, 0);
+    co_spawn(ponger, 0);
+    co_run();
+    printf(1, "%d round trips between coroutines: %d ticks\n", ROUNDS, uptime() - start);
+
+    if(pipe(a) < 0 || pipe(b) < 0){
+        printf(1, "cobench: pipe failed\n");
+        exit();
+    }
+    start = uptime();
+    if(fork() == 0){
+        while(read(a[0], &v, sizeof(v)) == sizeof(v))
+            write(b[1], &v, sizeof(v));
+        exit();
+    }
+    for(i = 0; i < ROUNDS; i++){
+        write(a[1], &i, sizeof(i));
+        read(b[0], &v, sizeof(v));
+    }
+    close(a[1]);
+    wait();
+    printf(1, "%d round trips between processes: %d ticks\n", ROUNDS, uptime() - start);
+
+    start = uptime();
+    for(i = 0; i < TASKS; i++)
+        co_spawn(nothing, 0);
+    co_run();
+    printf(1, "%d coroutines: %d ticks\n", TASKS, uptime() - start);
+
+    start = uptime();
+    for(i = 0; i < TASKS; i++){
+        if(fork() == 0)
+            exit();
+        wait();
+    }
+    printf(1, "%d processes: %d ticks\n", TASKS, uptime() - start);
+
+    exit();
+}
@@ -0,0 +1,87 @@
+// Kernel copy benchmark. Reads a file small enough to stay in the
+// buffer cache, so the time goes into copying blocks out of the cache,
+// and forks a process with a large heap, which copies its pages.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define FILESZ  (16*1024)
+#define READS   200
+#define HEAPSZ  (256*1024)
+#define FORKS   50
+
+char buf[4096];
+
+int
+readbench(void)
+{
+    int fd, i, n, start;
+
+    if((fd = open("copybench.tmp", O_CREATE | O_RDWR)) < 0){
+        printf(1, "copybench: cannot create file\n");
+        return -1;
+    }
+
+    memset(buf, 'c', sizeof(buf));
+
+    for(i = 0; i < FILESZ; i += sizeof(buf))
+        write(fd, buf, sizeof(buf));
+
+    close(fd);
+
+    start = uptime();
+
+    for(i = 0; i < READS; i++){
+        fd = open("copybench.tmp", O_RDONLY);
+
+        while((n = read(fd, buf, sizeof(buf))) > 0)
+            ;
+
+        close(fd);
+    }
+
+    printf(1, "read %d KB from the cache: %d ticks\n", READS * FILESZ / 1024, uptime() - start);
+    unlink("copybench.tmp");
+    return 0;
+}
+
+int
+forkbench(void)
+{
+    char *heap;
+    int i, pid, start;
+
+    if((heap = sbrk(HEAPSZ)) == (char*)-1){
+        printf(1, "copybench: sbrk failed\n");
+        return -1;
+    }
+
+    memset(heap, 'h', HEAPSZ);
+    start = uptime();
+
+    for(i = 0; i < FORKS; i++){
+        if((pid = fork()) < 0){
+            printf(1, "copybench: fork failed\n");
+            return -1;
+        }
+
+        if(pid == 0)
+            exit();
+
+        wait();
+    }
+
+    printf(1, "%d forks of a %d KB process: %d ticks\n", FORKS, HEAPSZ / 1024, uptime() - start);
+    sbrk(-HEAPSZ);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    readbench();
+    forkbench();
+    exit();
+}
@@ -0,0 +1,225 @@
+#include "types.h"
+#include "user.h"
+#include "coro.h"
+
+#define STACKSZ     4096
+
+void coswtch(struct cocontext**, struct cocontext*);
+
+static struct coro *current;        // 0 in co_run itself
+static struct cocontext *schedctx;  // where co_run waits
+static struct coqueue runq;
+
+static void
+enqueue(struct coqueue *q, struct coro *c)
+{
+    c->next = 0;
+    if(q->tail)
+        q->tail->next = c;
+    else
+        q->head = c;
+    q->tail = c;
+}
+
+static struct coro*
+dequeue(struct coqueue *q)
+{
+    struct coro *c;
+
+    if((c = q->head) != 0){
+        q->head = c->next;
+        if(q->head == 0)
+            q->tail = 0;
+    }
+    return c;
+}
+
+// Go back to co_run. The current coroutine must be on a queue (or
+// dead), or it never runs again.
+static void
+cosched(void)
+{
+    coswtch(&current->ctx, schedctx);
+}
+
+// The first thing a new coroutine runs.
+static void
+costart(void)
+{
+    current->fn(current->arg);
+    current->dead = 1;
+    cosched();
+}
+
+// Make a coroutine to run fn(arg) on its own stack. It first runs
+// in co_run.
+int
+co_spawn(void (*fn)(void*), void *arg)
+{
+    struct coro *c;
+
+    if((c = malloc(sizeof(*c))) == 0)
+        return -1;
+    if((c->stack = malloc(STACKSZ)) == 0){
+        free(c);
+        return -1;
+    }
+
+    c->fn = fn;
+    c->arg = arg;
+    c->dead = 0;
+
+    // a context that coswtch returns from into costart
+    c->ctx = (struct cocontext*)(c->stack + STACKSZ) - 1;
+    memset(c->ctx, 0, sizeof(*c->ctx));
+    c->ctx->lr = (uint)costart;
+
+    enqueue(&runq, c);
+    return 0;
+}
+
+// Let the other runnable coroutines run.
+void
+co_yield(void)
+{
+    if(current == 0)
+        return;
+    enqueue(&runq, current);
+    cosched();
+}
+
+// Run coroutines until none is runnable: all have returned, or the
+// rest wait on channels.
+void
+co_run(void)
+{
+    struct coro *c;
+
+    while((c = dequeue(&runq)) != 0){
+        current = c;
+        coswtch(&schedctx, c->ctx);
+        current = 0;
+
+        // it no longer runs on its stack
+        if(c->dead){
+            free(c->stack);
+            free(c);
+        }
+    }
+}
+
+// Put the current coroutine on q, to wait there once it calls
+// cosched. Only a coroutine can wait.
+static int
+block(struct coqueue *q)
+{
+    if(current == 0)
+        return -1;
+    current->ok = 0;
+    enqueue(q, current);
+    return 0;
+}
+
+struct chan*
+chan_new(uint cap)
+{
+    struct chan *c;
+
+    if((c = malloc(sizeof(*c))) == 0)
+        return 0;
+    memset(c, 0, sizeof(*c));
+    if(cap > 0 && (c->buf = malloc(cap * sizeof(int))) == 0){
+        free(c);
+        return 0;
+    }
+    c->cap = cap;
+    return c;
+}
+
+void
+chan_free(struct chan *c)
+{
+    if(c->buf)
+        free(c->buf);
+    free(c);
+}
+
+// Send v on c, waiting while it is full. Returns -1 if c is closed,
+// or if it is full and the caller is not a coroutine.
+int
+chan_send(struct chan *c, int v)
+{
+    struct coro *r;
+
+    if(c->closed)
+        return -1;
+
+    // a waiting receiver takes it straight away
+    if((r = dequeue(&c->recvq)) != 0){
+        r->val = v;
+        r->ok = 1;
+        enqueue(&runq, r);
+        return 0;
+    }
+
+    if(c->tail - c->head < c->cap){
+        c->buf[c->tail++ % c->cap] = v;
+        return 0;
+    }
+
+    if(block(&c->sendq) < 0)
+        return -1;
+    current->val = v;
+    cosched();
+    return current->ok ? 0 : -1;
+}
+
+// Receive a value from c into *v, waiting while it is empty. Returns
+// 1, or 0 if c is closed and drained, or if it is empty and the
+// caller is not a coroutine.
+int
+chan_recv(struct chan *c, int *v)
+{
+    struct coro *s;
+
+    if(c->tail != c->head){
+        *v = c->buf[c->head++ % c->cap];
+
+        // the room goes to the first waiting sender
+        if((s = dequeue(&c->sendq)) != 0){
+            c->buf[c->tail++ % c->cap] = s->val;
+            s->ok = 1;
+            enqueue(&runq, s);
+        }
+        return 1;
+    }
+
+    if((s = dequeue(&c->sendq)) != 0){
+        *v = s->val;
+        s->ok = 1;
+        enqueue(&runq, s);
+        return 1;
+    }
+
+    if(c->closed || block(&c->recvq) < 0)
+        return 0;
+    cosched();
+    if(!current->ok)
+        return 0;
+    *v = current->val;
+    return 1;
+}
+
+// No more values will be sent. Waiting senders fail, and waiting
+// receivers find the channel empty.
+void
+chan_close(struct chan *c)
+{
+    struct coro *w;
+
+    c->closed = 1;
+    while((w = dequeue(&c->sendq)) != 0)
+        enqueue(&runq, w);
+    while((w = dequeue(&c->recvq)) != 0)
+        enqueue(&runq, w);
+}
@@ -0,0 +1,55 @@
+// Coroutines: cooperative threads inside one process, switched
+// without system calls. A coroutine runs until it yields, blocks on
+// a channel, or returns.
+
+// Registers saved by coswtch, at the top of a suspended stack.
+struct cocontext {
+    uint r4;
+    uint r5;
+    uint r6;
+    uint r7;
+    uint r8;
+    uint r9;
+    uint r10;
+    uint r11;
+    uint r12;
+    uint lr;
+};
+
+struct coro {
+    struct cocontext *ctx;      // where coswtch left it
+    char *stack;
+    void (*fn)(void*);
+    void *arg;
+    int dead;
+    int val;                    // value being passed on a channel
+    int ok;                     // the channel passed it
+    struct coro *next;          // on the run queue or a channel
+};
+
+struct coqueue {
+    struct coro *head;
+    struct coro *tail;
+};
+
+// A channel of ints with room for cap of them; with cap 0 a send
+// waits for a receiver.
+struct chan {
+    int *buf;
+    uint cap;
+    uint head;                  // values received
+    uint tail;                  // values sent
+    int closed;
+    struct coqueue sendq;       // waiting to send
+    struct coqueue recvq;       // waiting to receive
+};
+
+int co_spawn(void (*)(void*), void*);
+void co_yield(void);
+void co_run(void);
+
+struct chan* chan_new(uint);
+void chan_free(struct chan*);
+int chan_send(struct chan*, int);
+int chan_recv(struct chan*, int*);
+void chan_close(struct chan*);
@@ -1,6 +1,7 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "stdio.h"
 
 int
 main(int argc, char *argv[])
@@ -8,6 +9,7 @@ main(int argc, char *argv[])
     int i;
     
     for(i = 1; i < argc; i++)
-        printf(1, "%s%s", argv[i], i+1 < argc ? " " : "\n");
+        fprintf(stdout, "%s%s", argv[i], i+1 < argc ? " " : "\n");
+    fflush(stdout);
     exit();
 }
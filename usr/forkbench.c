@@ -0,0 +1,67 @@
+// Process creation benchmark: the cost of fork, vfork, fork+exec,
+// vfork+exec and spawn, with a heap of HEAPSZ that fork must copy.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define HEAPSZ  (256*1024)
+#define N       50
+
+char *argv[] = { "echo", 0 };
+
+int
+main(int argc, char *args[])
+{
+    int i, start;
+
+    if(sbrk(HEAPSZ) == (char*)-1){
+        printf(1, "forkbench: sbrk failed\n");
+        exit();
+    }
+
+    start = uptime();
+    for(i = 0; i < N; i++){
+        if(fork() == 0)
+            exit();
+        wait();
+    }
+    printf(1, "fork+exit:   %d ticks for %d\n", uptime() - start, N);
+
+    start = uptime();
+    for(i = 0; i < N; i++){
+        if(vfork() == 0)
+            exit();
+        wait();
+    }
+    printf(1, "vfork+exit:  %d ticks for %d\n", uptime() - start, N);
+
+    start = uptime();
+    for(i = 0; i < N; i++){
+        if(fork() == 0){
+            exec("echo", argv);
+            exit();
+        }
+        wait();
+    }
+    printf(1, "fork+exec:   %d ticks for %d\n", uptime() - start, N);
+
+    start = uptime();
+    for(i = 0; i < N; i++){
+        if(vfork() == 0){
+            exec("echo", argv);
+            exit();
+        }
+        wait();
+    }
+    printf(1, "vfork+exec:  %d ticks for %d\n", uptime() - start, N);
+
+    start = uptime();
+    for(i = 0; i < N; i++){
+        if(spawn("echo", argv, 0) > 0)
+            wait();
+    }
+    printf(1, "spawn:       %d ticks for %d\n", uptime() - start, N);
+
+    exit();
+}
@@ -1,106 +1,266 @@
 // Simple grep.  Only supports ^ . * $ operators.
+//
+// The pattern is compiled to a list of atoms, each a character or
+// '.' that may be starred, and lines are matched by simulating the
+// NFA of the atoms one byte at a time (Thompson's construction, in
+// the form of Cox, "Regular Expression Matching Can Be Simple And
+// Fast"). The sets of NFA positions are cached as DFA states, so a
+// byte usually costs one table lookup, and no pattern can take
+// exponential time the way backtracking can.
+//
+// Most patterns have a run of plain characters that every matching
+// line must contain. grep looks for that run with Boyer-Moore-
+// Horspool and only runs the matcher on the lines where it appears.
 
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "stdio.h"
 
-char buf[1024];
-int match(char*, char*);
+#define NATOM   31              // positions 0..NATOM fit in a uint
+#define NDSTATE 64              // cached DFA states
+#define ANY     256             // atom matching any character
 
+char buf[32*1024];
+
+int atom[NATOM];                // character, or ANY
+int star[NATOM];
+int natom;
+int bol, eol;                   // anchored by ^, $
+uint start, accept;             // NFA position sets
+
+uchar lit[NATOM];               // plain run every match contains
+int litlen;
+int skip[256];                  // Horspool shifts for lit
+
+uint dset[NDSTATE];             // NFA positions of each DFA state
+short dnext[NDSTATE][256];      // next DFA state, -1 if not yet known
+int ndstate;
+
+// Add the positions reachable from s by skipping starred atoms.
+uint
+closure(uint s)
+{
+    int i;
+
+    for(i = 0; i < natom; i++)
+        if((s & (1<<i)) && star[i])
+            s |= 1<<(i+1);
+    return s;
+}
+
+// Parse the pattern with the rules of the Kernighan & Pike matcher
+// it replaces: ^ is special only first, $ only last, and a * after
+// a starred atom is a plain character.
+int
+compile(char *re)
+{
+    int i, j, run;
+
+    if(*re == '^'){
+        bol = 1;
+        re++;
+    }
+    for(natom = 0; *re; natom++){
+        if(re[0] == '$' && re[1] == '\0'){
+            eol = 1;
+            break;
+        }
+        if(natom == NATOM)
+            return -1;
+        atom[natom] = *re == '.' ? ANY : (uchar)*re;
+        if(re[1] == '*'){
+            star[natom] = 1;
+            re += 2;
+        } else
+            re++;
+    }
+
+    start = closure(1);
+    accept = 1<<natom;
+
+    // find the longest run of plain atoms
+    run = 0;
+    for(i = 0; i <= natom; i++){
+        if(i < natom && atom[i] != ANY && !star[i]){
+            run++;
+            continue;
+        }
+        if(run > litlen){
+            litlen = run;
+            for(j = 0; j < run; j++)
+                lit[j] = atom[i-run+j];
+        }
+        run = 0;
+    }
+    for(i = 0; i < 256; i++)
+        skip[i] = litlen;
+    for(i = 0; i+1 < litlen; i++)
+        skip[(uchar)lit[i]] = litlen-1 - i;
+    return 0;
+}
+
+// Return the DFA state for the NFA positions s, adding it to the
+// cache. State 0 is always the start state.
+int
+dstate(uint s)
+{
+    int d;
+
+    for(d = 0; d < ndstate; d++)
+        if(dset[d] == s)
+            return d;
+    if(ndstate == NDSTATE){
+        ndstate = 1;
+        memset(dnext[0], 0xff, sizeof(dnext[0]));
+    }
+    d = ndstate++;
+    dset[d] = s;
+    memset(dnext[d], 0xff, sizeof(dnext[d]));
+    return d;
+}
+
+// Work out and cache the state after d on byte c.
+int
+dstep(int d, int c)
+{
+    uint s, t;
+    int i, n;
+
+    s = dset[d];
+    t = 0;
+    for(i = 0; i < natom; i++)
+        if((s & (1<<i)) && (atom[i] == ANY || atom[i] == c))
+            t |= star[i] ? 1<<i : 1<<(i+1);
+    t = closure(t);
+    if(!bol)
+        t |= start;
+
+    // the cache may be flushed, taking d with it
+    n = ndstate;
+    i = dstate(t);
+    if(ndstate >= n)
+        dnext[d][c] = i;
+    return i;
+}
+
+int
+matchline(char *p, char *e)
+{
+    int d, n;
+
+    d = 0;
+    for(; p < e; p++){
+        if((dset[d] & accept) && !eol)
+            return 1;
+        if((n = dnext[d][(uchar)*p]) < 0)
+            n = dstep(d, (uchar)*p);
+        d = n;
+    }
+    return (dset[d] & accept) != 0;
+}
+
+// Find lit in [p, e).
+char*
+findlit(char *p, char *e)
+{
+    int i, c;
+
+    for(; e - p >= litlen; p += skip[c]){
+        c = (uchar)p[litlen-1];
+        if(c != lit[litlen-1])
+            continue;
+        for(i = 0; i < litlen-1 && (uchar)p[i] == lit[i]; i++)
+            ;
+        if(i == litlen-1)
+            return p;
+    }
+    return 0;
+}
+
+// Print the matching lines in [p, e). Every line but the last ends
+// in a newline.
 void
-grep(char *pattern, int fd)
+scan(char *p, char *e)
+{
+    char *l, *q;
+
+    while(p < e){
+        if(litlen > 0){
+            if((l = findlit(p, e)) == 0)
+                return;
+            for(; l > p && l[-1] != '\n'; l--)
+                ;
+            p = l;
+        }
+        for(q = p; q < e && *q != '\n'; q++)
+            ;
+        if(matchline(p, q)){
+            if(q < e)
+                fwrite(p, 1, q+1 - p, stdout);
+            else {
+                fwrite(p, 1, q - p, stdout);
+                fputc('\n', stdout);
+            }
+        }
+        p = q+1;
+    }
+}
+
+void
+grep(int fd)
 {
     int n, m;
-    char *p, *q;
-    
+    char *end;
+
     m = 0;
     while((n = read(fd, buf+m, sizeof(buf)-m)) > 0){
         m += n;
-        p = buf;
-        while((q = strchr(p, '\n')) != 0){
-            *q = 0;
-            if(match(pattern, p)){
-                *q = '\n';
-                write(1, p, q+1 - p);
-            }
-            p = q+1;
-        }
-        if(p == buf)
-            m = 0;
-        if(m > 0){
-            m -= p - buf;
-            memmove(buf, p, m);
+        for(end = buf+m; end > buf && end[-1] != '\n'; end--)
+            ;
+        if(end == buf){
+            // a line longer than buf is skipped
+            if(m == sizeof(buf))
+                m = 0;
+            continue;
         }
+        scan(buf, end);
+        m -= end - buf;
+        memmove(buf, end, m);
     }
+    scan(buf, buf+m);
 }
 
 int
 main(int argc, char *argv[])
 {
     int fd, i;
-    char *pattern;
-    
+
     if(argc <= 1){
         printf(2, "usage: grep pattern [file ...]\n");
         exit();
     }
-    pattern = argv[1];
-    
+    if(compile(argv[1]) < 0){
+        printf(2, "grep: pattern too long\n");
+        exit();
+    }
+    dstate(start);
+
     if(argc <= 2){
-        grep(pattern, 0);
+        grep(0);
+        fflush(stdout);
         exit();
     }
-    
+
     for(i = 2; i < argc; i++){
         if((fd = open(argv[i], 0)) < 0){
-            printf(1, "grep: cannot open %s\n", argv[i]);
+            fprintf(stdout, "grep: cannot open %s\n", argv[i]);
+            fflush(stdout);
             exit();
         }
-        grep(pattern, fd);
+        grep(fd);
         close(fd);
     }
+    fflush(stdout);
     exit();
 }
-
-// Regexp matcher from Kernighan & Pike,
-// The Practice of Programming, Chapter 9.
-
-int matchhere(char*, char*);
-int matchstar(int, char*, char*);
-
-int
-match(char *re, char *text)
-{
-    if(re[0] == '^')
-        return matchhere(re+1, text);
-    do{  // must look at empty string
-        if(matchhere(re, text))
-            return 1;
-    }while(*text++ != '\0');
-    return 0;
-}
-
-// matchhere: search for re at beginning of text
-int matchhere(char *re, char *text)
-{
-    if(re[0] == '\0')
-        return 1;
-    if(re[1] == '*')
-        return matchstar(re[0], re+2, text);
-    if(re[0] == '$' && re[1] == '\0')
-        return *text == '\0';
-    if(*text!='\0' && (re[0]=='.' || re[0]==*text))
-        return matchhere(re+1, text+1);
-    return 0;
-}
-
-// matchstar: search for c*re at beginning of text
-int matchstar(int c, char *re, char *text)
-{
-    do{  // a * matches zero or more instances
-        if(matchhere(re, text))
-            return 1;
-    }while(*text!='\0' && (*text++==c || c=='.'));
-    return 0;
-}
-
@@ -21,9 +21,9 @@ main(void)
     
     for(;;){
         printf(1, "init: starting sh\n");
-        pid = fork();
+        pid = vfork();
         if(pid < 0){
-            printf(1, "init: fork failed\n");
+            printf(1, "init: vfork failed\n");
             exit();
         }
         if(pid == 0){
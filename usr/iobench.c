@@ -0,0 +1,163 @@
+// Sequential file I/O benchmark. Writes a file and reads it back
+// with one-block requests and with large requests, which the
+// kernel can turn into clustered multi-block disk transfers. The
+// one-block requests are then made again through an I/O ring, a
+// batch per system call.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "ioring.h"
+
+#define FILESZ  (64*1024)
+#define ROUNDS  8
+
+#define RINGSZ  64
+
+char buf[8192];
+uint ringmem[IORING_SZ(RINGSZ) / sizeof(uint)];
+
+int
+run(char *name, int bsize)
+{
+    int fd, i, n, r, start, wt, rt;
+
+    start = uptime();
+
+    for(r = 0; r < ROUNDS; r++){
+        unlink(name);
+
+        if((fd = open(name, O_CREATE | O_RDWR)) < 0){
+            printf(1, "iobench: cannot create %s\n", name);
+            return -1;
+        }
+
+        for(i = 0; i < FILESZ; i += bsize){
+            if(write(fd, buf, bsize) != bsize){
+                printf(1, "iobench: write failed\n");
+                close(fd);
+                return -1;
+            }
+        }
+
+        close(fd);
+    }
+
+    wt = uptime() - start;
+    start = uptime();
+
+    for(r = 0; r < ROUNDS; r++){
+        if((fd = open(name, O_RDONLY)) < 0){
+            printf(1, "iobench: cannot open %s\n", name);
+            return -1;
+        }
+
+        for(i = 0; (n = read(fd, buf, bsize)) > 0; i += n)
+            ;
+
+        close(fd);
+
+        if(i != FILESZ){
+            printf(1, "iobench: short read %d\n", i);
+            return -1;
+        }
+    }
+
+    rt = uptime() - start;
+    unlink(name);
+
+    printf(1, "%d byte requests: write %d ticks, read %d ticks\n", bsize, wt, rt);
+    return 0;
+}
+
+// Do the n requests of bsize bytes of op on fd through ring r,
+// RINGSZ to a system call. Returns the bytes done.
+int
+ringio(struct ioring *r, int op, int fd, int n, int bsize)
+{
+    struct iocqe c;
+    int i, tot;
+
+    tot = 0;
+
+    for(i = 0; i < n; ){
+        while(i < n && ioring_prep(r, op, fd, buf, bsize, -1, i) == 0)
+            i++;
+
+        ring_enter(r, 0);
+
+        while(ioring_reap(r, &c))
+            if(c.res > 0)
+                tot += c.res;
+    }
+
+    return tot;
+}
+
+int
+runring(char *name, int bsize)
+{
+    struct ioring *r;
+    int fd, n, rnd, start, wt, rt;
+
+    r = ioring_init(ringmem, RINGSZ);
+    n = FILESZ / bsize;
+    start = uptime();
+
+    for(rnd = 0; rnd < ROUNDS; rnd++){
+        unlink(name);
+
+        if((fd = open(name, O_CREATE | O_RDWR)) < 0){
+            printf(1, "iobench: cannot create %s\n", name);
+            return -1;
+        }
+
+        if(ringio(r, IO_WRITE, fd, n, bsize) != FILESZ){
+            printf(1, "iobench: ring write failed\n");
+            close(fd);
+            return -1;
+        }
+
+        close(fd);
+    }
+
+    wt = uptime() - start;
+    start = uptime();
+
+    for(rnd = 0; rnd < ROUNDS; rnd++){
+        if((fd = open(name, O_RDONLY)) < 0){
+            printf(1, "iobench: cannot open %s\n", name);
+            return -1;
+        }
+
+        if(ringio(r, IO_READ, fd, n, bsize) != FILESZ){
+            printf(1, "iobench: ring read failed\n");
+            close(fd);
+            return -1;
+        }
+
+        close(fd);
+    }
+
+    rt = uptime() - start;
+    unlink(name);
+
+    printf(1, "%d byte requests, %d per ring_enter: write %d ticks, read %d ticks\n",
+           bsize, RINGSZ, wt, rt);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    memset(buf, 'b', sizeof(buf));
+
+    printf(1, "iobench: %d rounds of %d bytes\n", ROUNDS, FILESZ);
+    run("iobench.tmp", 512);
+    run("iobench.tmp", 4096);
+    run("iobench.tmp", sizeof(buf));
+    runring("iobench.tmp", 512);
+
+    exit();
+}
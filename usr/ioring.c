@@ -0,0 +1,60 @@
+#include "types.h"
+#include "user.h"
+#include "ioring.h"
+
+// Keep the compiler from moving memory accesses across this point;
+// the kernel reads and writes the ring only inside ring_enter.
+#define barrier()   __asm__ volatile("" ::: "memory")
+
+// Set up a ring of size entries, a power of 2, in the
+// IORING_SZ(size) bytes at mem.
+struct ioring*
+ioring_init(void *mem, uint size)
+{
+    struct ioring *r;
+
+    if(size == 0 || size > IORING_MAX || (size & (size - 1)))
+        return 0;
+
+    r = mem;
+    memset(r, 0, IORING_SZ(size));
+    r->size = size;
+    return r;
+}
+
+// Queue an operation for the next ring_enter. Returns -1 if the
+// submission queue is full.
+int
+ioring_prep(struct ioring *r, int op, int fd, void *addr, uint len, int off, uint data)
+{
+    struct iosqe *e;
+
+    if(r->sqtail - r->sqhead == r->size)
+        return -1;
+
+    e = &r->sq[r->sqtail & (r->size - 1)];
+    e->op = op;
+    e->fd = fd;
+    e->addr = addr;
+    e->len = len;
+    e->off = off;
+    e->data = data;
+
+    barrier();
+    r->sqtail++;
+    return 0;
+}
+
+// Take the next completion into *c. Returns 0 if there is none.
+int
+ioring_reap(struct ioring *r, struct iocqe *c)
+{
+    if(r->cqhead == r->cqtail)
+        return 0;
+
+    *c = IORING_CQ(r)[r->cqhead & (r->size - 1)];
+
+    barrier();
+    r->cqhead++;
+    return 1;
+}
@@ -2,6 +2,9 @@
 #include "stat.h"
 #include "user.h"
 #include "fs.h"
+#include "stdio.h"
+
+#define NENT    32              // entries to read at once
 
 char*
 fmtname(char *path)
@@ -25,45 +28,42 @@ fmtname(char *path)
 void
 ls(char *path)
 {
+    static struct direntplus de[NENT];
     char buf[512], *p;
-    int fd;
-    struct dirent de;
+    int fd, i, n;
     struct stat st;
     
     if((fd = open(path, 0)) < 0){
-        printf(2, "ls: cannot open %s\n", path);
+        fprintf(stderr, "ls: cannot open %s\n", path);
         return;
     }
     
     if(fstat(fd, &st) < 0){
-        printf(2, "ls: cannot stat %s\n", path);
+        fprintf(stderr, "ls: cannot stat %s\n", path);
         close(fd);
         return;
     }
     
     switch(st.type){
         case T_FILE:
-            printf(1, "%s %d %d %d\n", fmtname(path), st.type, st.ino, st.size);
+            fprintf(stdout, "%s %d %d %d\n", fmtname(path), st.type, st.ino, st.size);
             break;
             
         case T_DIR:
             if(strlen(path) + 1 + DIRSIZ + 1 > sizeof buf){
-                printf(1, "ls: path too long\n");
+                fprintf(stdout, "ls: path too long\n");
                 break;
             }
             strcpy(buf, path);
             p = buf+strlen(buf);
             *p++ = '/';
-            while(read(fd, &de, sizeof(de)) == sizeof(de)){
-                if(de.inum == 0)
-                    continue;
-                memmove(p, de.name, DIRSIZ);
-                p[DIRSIZ] = 0;
-                if(stat(buf, &st) < 0){
-                    printf(1, "ls: cannot stat %s\n", buf);
-                    continue;
+            // a batch of entries at a time, with no stat of each
+            while((n = readdirplus(fd, de, NENT)) > 0){
+                for(i = 0; i < n; i++){
+                    memmove(p, de[i].name, DIRSIZ);
+                    p[DIRSIZ] = 0;
+                    fprintf(stdout, "%s %d %d %d\n", fmtname(buf), de[i].type, de[i].inum, de[i].size);
                 }
-                printf(1, "%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
             }
             break;
     }
@@ -77,9 +77,11 @@ main(int argc, char *argv[])
     
     if(argc < 2){
         ls(".");
+        fflush(stdout);
         exit();
     }
     for(i=1; i<argc; i++)
         ls(argv[i]);
+    fflush(stdout);
     exit();
 }
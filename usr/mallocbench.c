@@ -0,0 +1,54 @@
+// Allocator benchmark. Keeps a set of small blocks live while
+// replacing them one at a time with blocks of other sizes, which
+// leaves the heap full of holes, then allocates and frees large
+// blocks.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define LIVE    512
+#define ROUNDS  50000
+#define BIG     200
+
+void *live[LIVE];
+uint seed = 1;
+
+uint
+rand(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int i, j, start;
+
+    start = uptime();
+    for(i = 0; i < ROUNDS; i++){
+        j = rand() % LIVE;
+        if(live[j])
+            free(live[j]);
+        if((live[j] = malloc(8 + rand() % 256)) == 0){
+            printf(1, "mallocbench: out of memory\n");
+            exit();
+        }
+    }
+    printf(1, "%d small mallocs and frees: %d ticks\n", ROUNDS, uptime() - start);
+
+    start = uptime();
+    for(i = 0; i < BIG; i++){
+        for(j = 0; j < 16; j++)
+            if((live[j] = malloc(4096 + rand() % 8192)) == 0){
+                printf(1, "mallocbench: out of memory\n");
+                exit();
+            }
+        for(j = 0; j < 16; j++)
+            free(live[j]);
+    }
+    printf(1, "%d large mallocs and frees: %d ticks\n", BIG * 16, uptime() - start);
+
+    exit();
+}
@@ -1,15 +1,10 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "stdio.h"
 
 static void
-putc(int fd, char c)
-{
-    write(fd, &c, 1);
-}
-
-static void
-printint(int fd, int xx, int base, int sgn)
+printint(FILE *f, int xx, int base, int sgn)
 {
     static char digits[] = "0123456789ABCDEF";
     char buf[16];
@@ -32,33 +27,31 @@ printint(int fd, int xx, int base, int sgn)
         buf[i++] = '-';
     
     while(--i >= 0)
-        putc(fd, buf[i]);
+        fputc(buf[i], f);
 }
 
-// Print to the given fd. Only understands %d, %x, %p, %s.
-void
-printf(int fd, char *fmt, ...)
+// Format into f. Only understands %d, %x, %p, %s, %c.
+static void
+vfprintf(FILE *f, char *fmt, uint *ap)
 {
     char *s;
     int c, i, state;
-    uint *ap;
     
     state = 0;
-    ap = (uint*)(void*)&fmt + 1;
     for(i = 0; fmt[i]; i++){
         c = fmt[i] & 0xff;
         if(state == 0){
             if(c == '%'){
                 state = '%';
             } else {
-                putc(fd, c);
+                fputc(c, f);
             }
         } else if(state == '%'){
             if(c == 'd'){
-                printint(fd, *ap, 10, 1);
+                printint(f, *ap, 10, 1);
                 ap++;
             } else if(c == 'x' || c == 'p'){
-                printint(fd, *ap, 16, 0);
+                printint(f, *ap, 16, 0);
                 ap++;
             } else if(c == 's'){
                 s = (char*)*ap;
@@ -66,20 +59,43 @@ printf(int fd, char *fmt, ...)
                 if(s == 0)
                     s = "(null)";
                 while(*s != 0){
-                    putc(fd, *s);
+                    fputc(*s, f);
                     s++;
                 }
             } else if(c == 'c'){
-                putc(fd, *ap);
+                fputc(*ap, f);
                 ap++;
             } else if(c == '%'){
-                putc(fd, c);
+                fputc(c, f);
             } else {
                 // Unknown % sequence.  Print it to draw attention.
-                putc(fd, '%');
-                putc(fd, c);
+                fputc('%', f);
+                fputc(c, f);
             }
             state = 0;
         }
     }
 }
+
+void
+fprintf(FILE *f, char *fmt, ...)
+{
+    vfprintf(f, fmt, (uint*)(void*)&fmt + 1);
+}
+
+// Print to the given fd, with one write for every 128 bytes rather
+// than for every byte.
+void
+printf(int fd, char *fmt, ...)
+{
+    char buf[128];
+    FILE f;
+
+    f.fd = fd;
+    f.flags = F_WRITE | F_SET;
+    f.buf = buf;
+    f.size = sizeof(buf);
+    f.len = 0;
+    vfprintf(&f, fmt, (uint*)(void*)&fmt + 1);
+    fflush(&f);
+}
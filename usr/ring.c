@@ -0,0 +1,135 @@
+#include "types.h"
+#include "user.h"
+#include "ring.h"
+
+// Keep the compiler from moving memory accesses across this point.
+// We run on one CPU, so the hardware keeps them in order already.
+#define barrier()   __asm__ volatile("" ::: "memory")
+
+// Set up a ring in the memsz bytes at mem, which the consumer maps
+// too. The data area is the largest power of 2 that fits.
+struct ring*
+ring_init(void *mem, uint memsz)
+{
+    struct ring *r;
+    uint size;
+
+    r = mem;
+
+    if(memsz <= sizeof(*r))
+        return 0;
+
+    for(size = 1; size * 2 <= memsz - sizeof(*r); size *= 2)
+        ;
+
+    r->head = 0;
+    r->tail = 0;
+    r->closed = 0;
+    r->size = size;
+    return r;
+}
+
+// The producer is done; the consumer sees the end once the ring
+// is drained.
+void
+ring_close(struct ring *r)
+{
+    barrier();
+    r->closed = 1;
+}
+
+// Return where the producer can write, and in *n how many bytes, at
+// least 1. Waits while the ring is full.
+char*
+ring_wspan(struct ring *r, uint *n)
+{
+    uint head, room;
+
+    head = r->head;
+
+    while((room = r->size - (head - r->tail)) == 0)
+        sleep(0);
+
+    *n = r->size - (head & (r->size - 1));
+    if(*n > room)
+        *n = room;
+
+    return r->data + (head & (r->size - 1));
+}
+
+// Publish n bytes written at ring_wspan.
+void
+ring_wcommit(struct ring *r, uint n)
+{
+    barrier();
+    r->head += n;
+}
+
+// Return where the consumer can read, and in *n how many bytes.
+// Waits while the ring is empty; returns 0 at the end.
+char*
+ring_rspan(struct ring *r, uint *n)
+{
+    uint tail, avail;
+
+    tail = r->tail;
+
+    while((avail = r->head - tail) == 0){
+        if(r->closed && r->head == tail)
+            return 0;
+        sleep(0);
+    }
+
+    barrier();
+
+    *n = r->size - (tail & (r->size - 1));
+    if(*n > avail)
+        *n = avail;
+
+    return r->data + (tail & (r->size - 1));
+}
+
+// Release n bytes read at ring_rspan.
+void
+ring_rcommit(struct ring *r, uint n)
+{
+    barrier();
+    r->tail += n;
+}
+
+// Copy n bytes into the ring.
+int
+ring_write(struct ring *r, void *buf, uint n)
+{
+    char *p;
+    uint i, m;
+
+    for(i = 0; i < n; i += m){
+        p = ring_wspan(r, &m);
+        if(m > n - i)
+            m = n - i;
+        memmove(p, (char*)buf + i, m);
+        ring_wcommit(r, m);
+    }
+
+    return n;
+}
+
+// Copy up to n bytes out of the ring; fewer only at the end.
+int
+ring_read(struct ring *r, void *buf, uint n)
+{
+    char *p;
+    uint i, m;
+
+    for(i = 0; i < n; i += m){
+        if((p = ring_rspan(r, &m)) == 0)
+            break;
+        if(m > n - i)
+            m = n - i;
+        memmove((char*)buf + i, p, m);
+        ring_rcommit(r, m);
+    }
+
+    return i;
+}
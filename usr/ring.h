@@ -0,0 +1,30 @@
+// Single-producer single-consumer byte ring, for a producer and a
+// consumer process sharing memory (see shmopen). Neither side makes
+// system calls except to wait when the ring is full or empty.
+//
+// The producer only writes head, the consumer only writes tail;
+// both count bytes from the start and wrap around freely.
+
+struct ring {
+    volatile uint head;         // bytes produced
+    uint pad0[7];               // head and tail in separate cache lines
+    volatile uint tail;         // bytes consumed
+    uint pad1[7];
+    volatile uint closed;       // producer is done
+    uint size;                  // bytes in data, a power of 2
+    uint pad2[6];
+    char data[];
+};
+
+struct ring* ring_init(void*, uint);
+void ring_close(struct ring*);
+
+// zero-copy interface: get a contiguous span, fill or drain it,
+// then commit the bytes used
+char* ring_wspan(struct ring*, uint*);
+void ring_wcommit(struct ring*, uint);
+char* ring_rspan(struct ring*, uint*);
+void ring_rcommit(struct ring*, uint);
+
+int ring_write(struct ring*, void*, uint);
+int ring_read(struct ring*, void*, uint);
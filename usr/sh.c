@@ -131,6 +131,53 @@ runcmd(struct cmd *cmd)
     exit();
 }
 
+// Run a simple command (with redirections, but no pipes, lists or
+// background) with spawn, which is much cheaper than fork and exec:
+// the shell is not copied. Returns the pid to wait for, 0 if there
+// is none, or -1 if the command is not simple.
+int
+spawncmd(struct cmd *cmd)
+{
+    int fdmap[3] = {0, 1, 2};
+    struct redircmd *rcmd;
+    struct execcmd *ecmd;
+    struct cmd *c;
+    int i, pid;
+
+    for(c = cmd; c && c->type == REDIR; c = ((struct redircmd*)c)->cmd)
+        if(((struct redircmd*)c)->fd > 2)
+            return -1;
+
+    if(c == 0 || c->type != EXEC)
+        return -1;
+
+    ecmd = (struct execcmd*)c;
+    if(ecmd->argv[0] == 0)
+        return 0;
+
+    // the outermost redirection comes first, as in runcmd
+    pid = 0;
+    for(c = cmd; c->type == REDIR; c = rcmd->cmd){
+        rcmd = (struct redircmd*)c;
+        if(fdmap[rcmd->fd] > 2)
+            close(fdmap[rcmd->fd]);
+        if((fdmap[rcmd->fd] = open(rcmd->file, rcmd->mode)) < 0){
+            printf(2, "open %s failed\n", rcmd->file);
+            pid = -1;
+            break;
+        }
+    }
+
+    if(pid == 0 && (pid = spawn(ecmd->argv[0], ecmd->argv, fdmap)) < 0)
+        printf(2, "exec %s failed\n", ecmd->argv[0]);
+
+    for(i = 0; i < 3; i++)
+        if(fdmap[i] > 2)
+            close(fdmap[i]);
+
+    return pid < 0 ? 0 : pid;
+}
+
 int
 getcmd(char *buf, int nbuf)
 {
@@ -146,7 +193,8 @@ int
 main(void)
 {
     static char buf[100];
-    int fd;
+    struct cmd *cmd;
+    int fd, pid;
     
     // Assumes three file descriptors open.
     while((fd = open("console", O_RDWR)) >= 0){
@@ -166,9 +214,15 @@ main(void)
                 printf(2, "cannot cd %s\n", buf+3);
             continue;
         }
-        if(fork1() == 0)
-            runcmd(parsecmd(buf));
-        wait();
+        if((cmd = parsecmd(buf)) == 0)
+            continue;
+        if((pid = spawncmd(cmd)) < 0){
+            if(fork1() == 0)
+                runcmd(cmd);
+            pid = 1;
+        }
+        if(pid > 0)
+            wait();
     }
     exit();
 }
@@ -194,12 +248,31 @@ fork1(void)
 //PAGEBREAK!
 // Constructors
 
+// The shell parses each line itself, to spawn simple commands, so
+// the commands are allocated from memory that is reused for every
+// line instead of from the heap.
+char cmdmem[8192];
+uint cmdused;
+
+void*
+cmdalloc(uint n)
+{
+    void *p;
+
+    n = (n + 3) & ~3;
+    if(cmdused + n > sizeof(cmdmem))
+        return malloc(n);
+    p = cmdmem + cmdused;
+    cmdused += n;
+    return p;
+}
+
 struct cmd*
 execcmd(void)
 {
     struct execcmd *cmd;
     
-    cmd = malloc(sizeof(*cmd));
+    cmd = cmdalloc(sizeof(*cmd));
     memset(cmd, 0, sizeof(*cmd));
     cmd->type = EXEC;
     return (struct cmd*)cmd;
@@ -210,7 +283,7 @@ redircmd(struct cmd *subcmd, char *file, char *efile, int mode, int fd)
 {
     struct redircmd *cmd;
     
-    cmd = malloc(sizeof(*cmd));
+    cmd = cmdalloc(sizeof(*cmd));
     memset(cmd, 0, sizeof(*cmd));
     cmd->type = REDIR;
     cmd->cmd = subcmd;
@@ -226,7 +299,7 @@ pipecmd(struct cmd *left, struct cmd *right)
 {
     struct pipecmd *cmd;
     
-    cmd = malloc(sizeof(*cmd));
+    cmd = cmdalloc(sizeof(*cmd));
     memset(cmd, 0, sizeof(*cmd));
     cmd->type = PIPE;
     cmd->left = left;
@@ -239,7 +312,7 @@ listcmd(struct cmd *left, struct cmd *right)
 {
     struct listcmd *cmd;
     
-    cmd = malloc(sizeof(*cmd));
+    cmd = cmdalloc(sizeof(*cmd));
     memset(cmd, 0, sizeof(*cmd));
     cmd->type = LIST;
     cmd->left = left;
@@ -252,7 +325,7 @@ backcmd(struct cmd *subcmd)
 {
     struct backcmd *cmd;
     
-    cmd = malloc(sizeof(*cmd));
+    cmd = cmdalloc(sizeof(*cmd));
     memset(cmd, 0, sizeof(*cmd));
     cmd->type = BACK;
     cmd->cmd = subcmd;
@@ -261,6 +334,15 @@ backcmd(struct cmd *subcmd)
 //PAGEBREAK!
 // Parsing
 
+char *parseerr;     // first error in the line being parsed
+
+void
+parseerror(char *s)
+{
+    if(parseerr == 0)
+        parseerr = s;
+}
+
 char whitespace[] = " \t\r\n\v";
 char symbols[] = "<|>&;()";
 
@@ -332,12 +414,18 @@ parsecmd(char *s)
     char *es;
     struct cmd *cmd;
     
+    cmdused = 0;
+    parseerr = 0;
     es = s + strlen(s);
     cmd = parseline(&s, es);
     peek(&s, es, "");
-    if(s != es){
+    if(s != es && parseerr == 0){
         printf(2, "leftovers: %s\n", s);
-        panic("syntax");
+        parseerror("syntax");
+    }
+    if(parseerr){
+        printf(2, "%s\n", parseerr);
+        return 0;
     }
     nulterminate(cmd);
     return cmd;
@@ -381,8 +469,10 @@ parseredirs(struct cmd *cmd, char **ps, char *es)
     
     while(peek(ps, es, "<>")){
         tok = gettoken(ps, es, 0, 0);
-        if(gettoken(ps, es, &q, &eq) != 'a')
-            panic("missing file for redirection");
+        if(gettoken(ps, es, &q, &eq) != 'a'){
+            parseerror("missing file for redirection");
+            break;
+        }
         switch(tok){
             case '<':
                 cmd = redircmd(cmd, q, eq, O_RDONLY, 0);
@@ -407,8 +497,10 @@ parseblock(char **ps, char *es)
         panic("parseblock");
     gettoken(ps, es, 0, 0);
     cmd = parseline(ps, es);
-    if(!peek(ps, es, ")"))
-        panic("syntax - missing )");
+    if(!peek(ps, es, ")")){
+        parseerror("syntax - missing )");
+        return cmd;
+    }
     gettoken(ps, es, 0, 0);
     cmd = parseredirs(cmd, ps, es);
     return cmd;
@@ -433,13 +525,17 @@ parseexec(char **ps, char *es)
     while(!peek(ps, es, "|)&;")){
         if((tok=gettoken(ps, es, &q, &eq)) == 0)
             break;
-        if(tok != 'a')
-            panic("syntax");
+        if(tok != 'a'){
+            parseerror("syntax");
+            break;
+        }
+        if(argc >= MAXARGS - 1){
+            parseerror("too many args");
+            break;
+        }
         cmd->argv[argc] = q;
         cmd->eargv[argc] = eq;
         argc++;
-        if(argc >= MAXARGS)
-            panic("too many args");
         ret = parseredirs(ret, ps, es);
     }
     cmd->argv[argc] = 0;
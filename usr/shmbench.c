@@ -0,0 +1,89 @@
+// IPC benchmark. A producer process sends TOTAL bytes to a consumer
+// in MSGSZ messages, first through a pipe, then through a ring in a
+// shared memory segment, which needs no system call per message.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "mman.h"
+#include "ring.h"
+
+#define TOTAL   (2*1024*1024)
+#define MSGSZ   512
+#define SHMSZ   (64*1024)
+
+char msg[MSGSZ];
+
+int
+pipebench(void)
+{
+    int fds[2], i, n, start;
+
+    if(pipe(fds) < 0){
+        printf(1, "shmbench: pipe failed\n");
+        return -1;
+    }
+
+    start = uptime();
+
+    if(fork() == 0){
+        close(fds[0]);
+        for(i = 0; i < TOTAL; i += MSGSZ)
+            write(fds[1], msg, MSGSZ);
+        exit();
+    }
+
+    close(fds[1]);
+
+    for(i = 0; (n = read(fds[0], msg, MSGSZ)) > 0; i += n)
+        ;
+
+    close(fds[0]);
+    wait();
+
+    printf(1, "pipe: %d KB in %d ticks\n", i / 1024, uptime() - start);
+    return 0;
+}
+
+int
+ringbench(void)
+{
+    struct ring *r;
+    char *mem;
+    int fd, i, n, start;
+
+    if((fd = shmopen("shmbench", SHMSZ)) < 0 ||
+       (mem = mmap(0, SHMSZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED){
+        printf(1, "shmbench: cannot map shared memory\n");
+        return -1;
+    }
+
+    close(fd);
+    r = ring_init(mem, SHMSZ);
+    start = uptime();
+
+    if(fork() == 0){
+        for(i = 0; i < TOTAL; i += MSGSZ)
+            ring_write(r, msg, MSGSZ);
+        ring_close(r);
+        exit();
+    }
+
+    for(i = 0; (n = ring_read(r, msg, MSGSZ)) > 0; i += n)
+        ;
+
+    wait();
+    munmap(mem, SHMSZ);
+
+    printf(1, "shared memory ring: %d KB in %d ticks\n", i / 1024, uptime() - start);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    memset(msg, 'm', sizeof(msg));
+    pipebench();
+    ringbench();
+    exit();
+}
@@ -0,0 +1,265 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "stdio.h"
+
+static char iobuf[NSTDIO][BUFSIZ];
+
+FILE _iob[NSTDIO] = {
+    { 0, F_READ, iobuf[0], BUFSIZ },
+    { 1, F_WRITE, iobuf[1], BUFSIZ },
+    { 2, F_WRITE | F_LINE | F_SET, iobuf[2], BUFSIZ },
+};
+
+// Open the file path for reading ("r") or writing ("w"). There is no
+// O_TRUNC, so "w" replaces the file with an empty one.
+FILE*
+fopen(char *path, char *mode)
+{
+    FILE *f;
+    int fd, flags;
+
+    if(strcmp(mode, "r") == 0){
+        fd = open(path, O_RDONLY);
+        flags = F_READ;
+    } else if(strcmp(mode, "w") == 0){
+        unlink(path);
+        fd = open(path, O_CREATE | O_WRONLY);
+        flags = F_WRITE;
+    } else
+        return 0;
+    if(fd < 0)
+        return 0;
+
+    for(f = _iob; f < _iob + NSTDIO; f++){
+        if(f->flags == 0){
+            f->fd = fd;
+            f->flags = flags;
+            f->buf = iobuf[f - _iob];
+            f->size = BUFSIZ;
+            f->pos = f->len = 0;
+            return f;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+int
+fclose(FILE *f)
+{
+    int r;
+
+    r = fflush(f);
+    close(f->fd);
+    f->flags = 0;
+    return r;
+}
+
+// Write out f's buffered output, or drop its buffered input.
+int
+fflush(FILE *f)
+{
+    uint i;
+    int n;
+
+    if(f->flags & F_READ){
+        f->pos = f->len = 0;
+        return 0;
+    }
+    for(i = 0; i < f->len; i += n){
+        if((n = write(f->fd, f->buf + i, f->len - i)) <= 0){
+            f->flags |= F_ERR;
+            f->len = 0;
+            return EOF;
+        }
+    }
+    f->len = 0;
+    return 0;
+}
+
+// Read more input into f's empty buffer. Returns EOF at the end of
+// the file or on an error.
+static int
+fill(FILE *f)
+{
+    int n;
+
+    if(!(f->flags & F_READ) || (f->flags & (F_EOF | F_ERR)))
+        return EOF;
+
+    // show a prompt before waiting for the answer
+    if(f == stdin && (stdout->flags & F_LINE))
+        fflush(stdout);
+
+    if((n = read(f->fd, f->buf, f->size)) <= 0){
+        f->flags |= n == 0 ? F_EOF : F_ERR;
+        return EOF;
+    }
+    f->pos = 0;
+    f->len = n;
+    return 0;
+}
+
+int
+fgetc(FILE *f)
+{
+    if(f->pos == f->len && fill(f) < 0)
+        return EOF;
+    return (uchar)f->buf[f->pos++];
+}
+
+// Read a line of at most n-1 bytes into s, with its newline. Returns
+// 0 if there was nothing left to read.
+char*
+fgets(char *s, int n, FILE *f)
+{
+    int i, c;
+
+    for(i = 0; i+1 < n; ){
+        if((c = fgetc(f)) == EOF)
+            break;
+        s[i++] = c;
+        if(c == '\n')
+            break;
+    }
+    s[i] = '\0';
+    return i > 0 ? s : 0;
+}
+
+uint
+fread(void *p, uint size, uint n, FILE *f)
+{
+    char *s;
+    uint i, m, total;
+    int cc;
+
+    if(size == 0)
+        return 0;
+    s = p;
+    total = size * n;
+    for(i = 0; i < total; i += m){
+        if(f->pos == f->len){
+            // read a large request straight into place
+            if(total - i >= f->size && (f->flags & F_READ) && !(f->flags & (F_EOF | F_ERR))){
+                if((cc = read(f->fd, s + i, total - i)) <= 0){
+                    f->flags |= cc == 0 ? F_EOF : F_ERR;
+                    break;
+                }
+                m = cc;
+                continue;
+            }
+            if(fill(f) < 0)
+                break;
+        }
+        m = f->len - f->pos;
+        if(m > total - i)
+            m = total - i;
+        memmove(s + i, f->buf + f->pos, m);
+        f->pos += m;
+    }
+    return i / size;
+}
+
+// Choose how f's output is buffered: by the line for the console.
+static int
+writable(FILE *f)
+{
+    struct stat st;
+
+    if(!(f->flags & F_WRITE))
+        return 0;
+    if(!(f->flags & F_SET)){
+        if(fstat(f->fd, &st) == 0 && st.type == T_DEV)
+            f->flags |= F_LINE;
+        f->flags |= F_SET;
+    }
+    return 1;
+}
+
+int
+fputc(int c, FILE *f)
+{
+    if(!writable(f))
+        return EOF;
+    f->buf[f->len++] = c;
+    if(f->len == f->size || (c == '\n' && (f->flags & F_LINE)))
+        if(fflush(f) < 0)
+            return EOF;
+    return (uchar)c;
+}
+
+int
+fputs(char *s, FILE *f)
+{
+    uint n;
+
+    n = strlen(s);
+    return fwrite(s, 1, n, f) == n ? 0 : EOF;
+}
+
+uint
+fwrite(void *p, uint size, uint n, FILE *f)
+{
+    char *s;
+    uint i, m, total;
+    int cc, nl;
+
+    if(size == 0 || !writable(f))
+        return 0;
+    s = p;
+    total = size * n;
+    nl = 0;
+    for(i = 0; i < total; i += m){
+        // write a large request straight from place
+        if(f->len == 0 && total - i >= f->size){
+            if((cc = write(f->fd, s + i, total - i)) <= 0){
+                f->flags |= F_ERR;
+                break;
+            }
+            m = cc;
+            continue;
+        }
+        m = f->size - f->len;
+        if(m > total - i)
+            m = total - i;
+        memmove(f->buf + f->len, s + i, m);
+        f->len += m;
+        if(f->len == f->size && fflush(f) < 0)
+            break;
+    }
+    if(f->flags & F_LINE){
+        for(m = 0; m < i && !nl; m++)
+            nl = s[m] == '\n';
+        if(nl)
+            fflush(f);
+    }
+    return i / size;
+}
+
+// Read a line from standard input into buf, with its newline; buf
+// is empty at the end of the input. Past what stdin has buffered,
+// gets reads a byte at a time and never beyond the newline: sh reads
+// its commands with it, and the rest of a script on its standard
+// input is for the commands it runs.
+char*
+gets(char *buf, int max)
+{
+    int i;
+    char c;
+
+    if(stdout->flags & F_LINE)
+        fflush(stdout);
+    for(i=0; i+1 < max; ){
+        if(stdin->pos < stdin->len)
+            c = stdin->buf[stdin->pos++];
+        else if(read(0, &c, 1) < 1)
+            break;
+        buf[i++] = c;
+        if(c == '\n' || c == '\r')
+            break;
+    }
+    buf[i] = '\0';
+    return buf;
+}
@@ -0,0 +1,52 @@
+// Buffered I/O on file descriptors. A FILE collects output and
+// writes it with one system call when its buffer fills, or at a
+// newline if it is line buffered, and reads input a buffer at a
+// time. stdout is line buffered when it is the console and fully
+// buffered otherwise; stderr is line buffered.
+//
+// Output still in a buffer is lost at exit, and written twice if the
+// process forks, so fflush it before either.
+
+#define BUFSIZ  512
+#define NSTDIO  8               // open FILEs per process
+#define EOF     (-1)
+
+// FILE flags
+#define F_READ  0x01
+#define F_WRITE 0x02
+#define F_EOF   0x04
+#define F_ERR   0x08
+#define F_LINE  0x10            // line buffered
+#define F_SET   0x20            // buffering has been chosen
+
+typedef struct {
+    int fd;
+    int flags;
+    char *buf;
+    uint size;                  // of buf
+    uint pos;                   // next byte of buf to read
+    uint len;                   // bytes in buf
+} FILE;
+
+extern FILE _iob[NSTDIO];
+
+#define stdin   (&_iob[0])
+#define stdout  (&_iob[1])
+#define stderr  (&_iob[2])
+
+#define feof(f)     (((f)->flags & F_EOF) != 0)
+#define ferror(f)   (((f)->flags & F_ERR) != 0)
+
+// stdio.c
+FILE* fopen(char*, char*);
+int fclose(FILE*);
+int fflush(FILE*);
+int fgetc(FILE*);
+char* fgets(char*, int, FILE*);
+uint fread(void*, uint, uint, FILE*);
+int fputc(int, FILE*);
+int fputs(char*, FILE*);
+uint fwrite(void*, uint, uint, FILE*);
+
+// printf.c
+void fprintf(FILE*, char*, ...);
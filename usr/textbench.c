@@ -0,0 +1,75 @@
+// Text tool benchmark. Runs wc and cat over a file of text, with
+// their output going into a pipe that is read and thrown away, as
+// at the end of a pipeline.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define FILESZ  (64*1024)
+#define RUNS    20
+
+char buf[4096];
+
+// Run argv with its output into a pipe, and read it all.
+void
+run(char **argv)
+{
+    int p[2];
+
+    if(pipe(p) < 0){
+        printf(1, "textbench: pipe failed\n");
+        exit();
+    }
+    if(fork() == 0){
+        close(1);
+        dup(p[1]);
+        close(p[0]);
+        close(p[1]);
+        exec(argv[0], argv);
+        printf(2, "textbench: exec %s failed\n", argv[0]);
+        exit();
+    }
+    close(p[1]);
+    while(read(p[0], buf, sizeof(buf)) > 0)
+        ;
+    close(p[0]);
+    wait();
+}
+
+void
+bench(char **argv)
+{
+    int i, start, t;
+
+    start = uptime();
+    for(i = 0; i < RUNS; i++)
+        run(argv);
+    t = uptime() - start;
+    printf(1, "%s: %d KB in %d ticks\n", argv[0], RUNS * FILESZ / 1024, t);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static char *wc[] = { "wc", "textbench.tmp", 0 };
+    static char *cat[] = { "cat", "textbench.tmp", 0 };
+    int fd, i, n;
+
+    if((fd = open("textbench.tmp", O_CREATE | O_RDWR)) < 0){
+        printf(1, "textbench: cannot create file\n");
+        exit();
+    }
+    for(i = 0; i < sizeof(buf); i++)
+        buf[i] = (i % 61 == 60) ? '\n' : (i % 7 == 6) ? ' ' : 'a' + i % 26;
+    for(n = 0; n < FILESZ; n += sizeof(buf))
+        write(fd, buf, sizeof(buf));
+    close(fd);
+
+    bench(wc);
+    bench(cat);
+
+    unlink("textbench.tmp");
+    exit();
+}
@@ -0,0 +1,127 @@
+#include "types.h"
+#include "user.h"
+#include "thread.h"
+
+#define STACKSZ     8192
+
+// The first function of a new thread.
+static void
+thread_start(void *arg)
+{
+    struct thread *t;
+
+    t = arg;
+    t->fn(t->arg);
+    thread_exit();
+}
+
+// Start fn(arg) in a new thread, described by t until thread_join.
+// Returns -1 if it cannot.
+int
+thread_create(struct thread *t, void (*fn)(void*), void *arg)
+{
+    if((t->stack = malloc(STACKSZ)) == 0)
+        return -1;
+
+    t->fn = fn;
+    t->arg = arg;
+
+    // the kernel sets t->tid before the thread runs
+    if(clone(thread_start, t, t->stack + STACKSZ, (int*)&t->tid) < 0){
+        free(t->stack);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Wait for t to exit, and free its stack.
+int
+thread_join(struct thread *t)
+{
+    int tid;
+
+    while((tid = t->tid) != 0)
+        futex_wait(&t->tid, tid);
+
+    free(t->stack);
+    return 0;
+}
+
+void
+thread_exit(void)
+{
+    exit();
+}
+
+// Mutexes follow Drepper, "Futexes Are Tricky": a lock that is only
+// ever taken by one thread at a time makes no system calls.
+
+void
+mutex_init(struct mutex *m)
+{
+    m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+    int c;
+
+    if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+        return;
+
+    // say there are waiters, and wait until it was free
+    if(c != 2)
+        c = __sync_lock_test_and_set(&m->state, 2);
+
+    while(c != 0){
+        futex_wait(&m->state, 2);
+        c = __sync_lock_test_and_set(&m->state, 2);
+    }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+    if(__sync_fetch_and_sub(&m->state, 1) != 1){
+        m->state = 0;
+        futex_wake(&m->state, 1);
+    }
+}
+
+void
+cond_init(struct cond *c)
+{
+    c->seq = 0;
+}
+
+// Release m and wait for a signal, then take m again. As with any
+// condition variable, the caller checks its condition in a loop.
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+    int seq;
+
+    seq = c->seq;
+    mutex_unlock(m);
+    futex_wait(&c->seq, seq);
+
+    // others may be waiting for m too
+    while(__sync_lock_test_and_set(&m->state, 2) != 0)
+        futex_wait(&m->state, 2);
+}
+
+void
+cond_signal(struct cond *c)
+{
+    __sync_fetch_and_add(&c->seq, 1);
+    futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+    __sync_fetch_and_add(&c->seq, 1);
+    futex_wake(&c->seq, 0x7fffffff);
+}
@@ -0,0 +1,31 @@
+// Threads: clone, with mutexes and condition variables built on
+// futex_wait and futex_wake. malloc is not safe to call from two
+// threads at once.
+
+struct thread {
+    volatile int tid;           // 0 once the thread has exited
+    void (*fn)(void*);
+    void *arg;
+    char *stack;
+};
+
+struct mutex {
+    volatile int state;         // 0 free, 1 held, 2 held with waiters
+};
+
+struct cond {
+    volatile int seq;           // bumped by each signal
+};
+
+int thread_create(struct thread*, void (*)(void*), void*);
+int thread_join(struct thread*);
+void thread_exit(void) __attribute__((noreturn));
+
+void mutex_init(struct mutex*);
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
+
+void cond_init(struct cond*);
+void cond_wait(struct cond*, struct mutex*);
+void cond_signal(struct cond*);
+void cond_broadcast(struct cond*);
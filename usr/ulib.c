@@ -75,24 +75,6 @@ strchr(const char *s, char c)
     return 0;
 }
 
-char*
-gets(char *buf, int max)
-{
-    int i, cc;
-    char c;
-    
-    for(i=0; i+1 < max; ){
-        cc = read(0, &c, 1);
-        if(cc < 1)
-            break;
-        buf[i++] = c;
-        if(c == '\n' || c == '\r')
-            break;
-    }
-    buf[i] = '\0';
-    return buf;
-}
-
 int
 stat(char *n, struct stat *st)
 {
@@ -3,8 +3,24 @@
 #include "user.h"
 #include "param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator.
+//
+// Small requests come from size classes: blocks of 16, 32, ... 2048
+// bytes, header included. Each class has a list of its free blocks
+// and a slab of sbrk'd memory that new blocks are cut from, so malloc
+// and free of a small block are a few loads and stores. A freed small
+// block goes back on its class's list; it is never merged or given to
+// another class.
+//
+// Larger requests, and small ones once sbrk fails, use the allocator
+// by Kernighan and Ritchie, The C programming Language, 2nd ed.
+// Section 8.7, which keeps free blocks in address order and merges
+// neighbours.
+
+#define NCLASS  8               // classes of 16 << 0 .. 16 << 7 bytes
+#define MINBLK  16
+#define SLABSZ  4096            // sbrk at least this much for a slab
+#define SMALL   0x80000000      // s.size of a small block: SMALL | class
 
 typedef long Align;
 
@@ -21,12 +37,15 @@ typedef union header Header;
 static Header base;
 static Header *freep;
 
-void
-free(void *ap)
+static Header *bins[NCLASS];    // free blocks of each class
+static char *slab[NCLASS];      // next block of each class to cut
+static char *slabend[NCLASS];
+
+static void
+bigfree(Header *bp)
 {
-    Header *bp, *p;
+    Header *p;
     
-    bp = (Header*)ap - 1;
     for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
         if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
             break;
@@ -43,6 +62,21 @@ free(void *ap)
     freep = p;
 }
 
+void
+free(void *ap)
+{
+    Header *bp;
+    uint k;
+
+    bp = (Header*)ap - 1;
+    if(bp->s.size & SMALL){
+        k = bp->s.size & ~SMALL;
+        bp->s.ptr = bins[k];
+        bins[k] = bp;
+    } else
+        bigfree(bp);
+}
+
 static Header*
 morecore(uint nu)
 {
@@ -56,12 +90,12 @@ morecore(uint nu)
         return 0;
     hp = (Header*)p;
     hp->s.size = nu;
-    free((void*)(hp + 1));
+    bigfree(hp);
     return freep;
 }
 
-void*
-malloc(uint nbytes)
+static void*
+bigmalloc(uint nbytes)
 {
     Header *p, *prevp;
     uint nunits;
@@ -88,3 +122,52 @@ malloc(uint nbytes)
                 return 0;
     }
 }
+
+// The class of blocks that fit nbytes, or -1 if they are too big.
+static int
+sizeclass(uint nbytes)
+{
+    int k;
+
+    if(nbytes > (MINBLK << (NCLASS-1)) - sizeof(Header))
+        return -1;
+    for(k = 0; (MINBLK << k) < nbytes + sizeof(Header); k++)
+        ;
+    return k;
+}
+
+static void*
+smallmalloc(int k)
+{
+    Header *p;
+    uint sz, n;
+
+    if((p = bins[k]) != 0)
+        bins[k] = p->s.ptr;
+    else {
+        sz = MINBLK << k;
+        if(slab[k] + sz > slabend[k]){
+            n = 8*sz > SLABSZ ? 8*sz : SLABSZ;
+            if((slab[k] = sbrk(n)) == (char*)-1){
+                slab[k] = slabend[k] = 0;
+                return 0;
+            }
+            slabend[k] = slab[k] + n;
+        }
+        p = (Header*)slab[k];
+        slab[k] += sz;
+    }
+    p->s.size = SMALL | k;
+    return (void*)(p + 1);
+}
+
+void*
+malloc(uint nbytes)
+{
+    void *p;
+    int k;
+
+    if((k = sizeclass(nbytes)) >= 0 && (p = smallmalloc(k)) != 0)
+        return p;
+    return bigmalloc(nbytes);
+}
@@ -1,8 +1,13 @@
 struct stat;
 struct pstat;
+struct iovec;
+struct ioring;
+struct pollfd;
+struct direntplus;
 
 // system calls
 int fork(void);
+int vfork(void);
 int exit(void) __attribute__((noreturn));
 int wait(void);
 int pipe(int*);
@@ -25,6 +30,22 @@ int sleep(int);
 int uptime(void);
 int settickets(int, int);
 int getpinfo(struct pstat*);
+void* mmap(void*, uint, int, int, int, uint);
+int munmap(void*, uint);
+int shmopen(char*, uint);
+int spawn(char*, char**, int*);
+int readv(int, struct iovec*, int);
+int writev(int, struct iovec*, int);
+int pread(int, void*, int, uint);
+int pwrite(int, void*, int, uint);
+int splice(int, int, int);
+int ring_enter(struct ioring*, int);
+int pipe2(int*, int);
+int poll(struct pollfd*, int, int);
+int clone(void (*)(void*), void*, void*, int*);
+int futex_wait(volatile int*, int);
+int futex_wake(volatile int*, int);
+int readdirplus(int, struct direntplus*, int);
 
 // ulib.c
 int stat(char*, struct stat*);
@@ -39,3 +60,9 @@ void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
+
+// ioring.c
+struct iocqe;
+struct ioring* ioring_init(void*, uint);
+int ioring_prep(struct ioring*, int, int, void*, uint, int, uint);
+int ioring_reap(struct ioring*, struct iocqe*);
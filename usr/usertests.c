@@ -4,8 +4,14 @@
 #include "user.h"
 #include "fs.h"
 #include "fcntl.h"
+#include "mman.h"
 #include "syscall.h"
 #include "memlayout.h"
+#include "uio.h"
+#include "ioring.h"
+#include "poll.h"
+#include "thread.h"
+#include "coro.h"
 
 char buf[8192];
 char name[3];
@@ -1482,6 +1488,890 @@ validatetest(void)
     printf(stdout, "validate ok\n");
 }
 
+// the kernel must refuse to copy to or from the guard page
+// below the user stack, although it lies within the process size
+void
+copyfault(void)
+{
+    int fd, fds[2];
+    char *guard;
+
+    printf(stdout, "copyfault test\n");
+    guard = (char*)(((uint)&fd & ~4095) - 4096);
+
+    fd = open("copyfault", O_CREATE | O_RDWR);
+    if(fd < 0 || write(fd, "0123456789", 10) != 10){
+        printf(stdout, "copyfault: cannot create file\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("copyfault", O_RDWR);
+    if(write(fd, guard, 10) != -1 || read(fd, guard, 10) != -1){
+        printf(stdout, "copyfault: file copy from/to guard page\n");
+        exit();
+    }
+    close(fd);
+    unlink("copyfault");
+
+    pipe(fds);
+    if(write(fds[1], guard, 10) != -1){
+        printf(stdout, "copyfault: pipe copy from guard page\n");
+        exit();
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    printf(stdout, "copyfault ok\n");
+}
+
+// reads come from the page cache, which must follow writes,
+// and must forget a file when it is deleted
+void
+pagecache(void)
+{
+    static char buf[6000];
+    int fd, i;
+
+    printf(stdout, "pagecache test\n");
+
+    for(i = 0; i < sizeof(buf); i++)
+        buf[i] = 'a' + i % 26;
+
+    fd = open("pagecache", O_CREATE | O_RDWR);
+    if(fd < 0 || write(fd, buf, sizeof(buf)) != sizeof(buf)){
+        printf(stdout, "pagecache: cannot create file\n");
+        exit();
+    }
+    close(fd);
+
+    // fill the cache, then write across the page boundary
+    fd = open("pagecache", O_RDWR);
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+        printf(stdout, "pagecache: read failed\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("pagecache", O_RDWR);
+    read(fd, buf, 4090);
+    write(fd, "0123456789", 10);
+    close(fd);
+
+    fd = open("pagecache", O_RDONLY);
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[4089] != 'a' + 4089 % 26
+       || buf[4090] != '0' || buf[4099] != '9' || buf[4100] != 'a' + 4100 % 26){
+        printf(stdout, "pagecache: stale data after write\n");
+        exit();
+    }
+    close(fd);
+    unlink("pagecache");
+
+    // a new file (likely reusing the inode) must not see the old data
+    fd = open("pagecache", O_CREATE | O_RDWR);
+    write(fd, "new", 3);
+    close(fd);
+
+    fd = open("pagecache", O_RDONLY);
+    if(read(fd, buf, sizeof(buf)) != 3 || buf[0] != 'n' || buf[2] != 'w'){
+        printf(stdout, "pagecache: stale data after unlink\n");
+        exit();
+    }
+    close(fd);
+    unlink("pagecache");
+
+    printf(stdout, "pagecache ok\n");
+}
+
+// file and anonymous memory mappings
+void
+mmaptest(void)
+{
+    char *p, *q;
+    int fd, i, pid;
+
+    printf(stdout, "mmap test\n");
+
+    for(i = 0; i < 5000; i++)
+        buf[i] = 'a' + i % 26;
+
+    fd = open("mmapfile", O_CREATE | O_RDWR);
+    if(fd < 0 || write(fd, buf, 5000) != 5000){
+        printf(stdout, "mmap: cannot create file\n");
+        exit();
+    }
+
+    // a private mapping shows the file, and writes stay private
+    p = mmap(0, 5000, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED || p[0] != 'a' || p[4999] != 'a' + 4999 % 26 || p[5000] != 0){
+        printf(stdout, "mmap: private mapping wrong\n");
+        exit();
+    }
+    p[1] = 'X';
+    if(munmap(p, 5000) < 0){
+        printf(stdout, "mmap: munmap failed\n");
+        exit();
+    }
+
+    // a shared mapping writes the file, and read() can use it
+    p = mmap(0, 5000, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED || p[1] != 'b'){
+        printf(stdout, "mmap: private write reached the file\n");
+        exit();
+    }
+    p[4096] = 'Y';
+    close(fd);
+    fd = open("mmapfile", O_RDONLY);
+    if(read(fd, p, 10) != 10 || munmap(p, 5000) < 0){
+        printf(stdout, "mmap: read into mapping failed\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("mmapfile", O_RDONLY);
+    if(read(fd, buf, 5000) != 5000 || buf[4096] != 'Y'){
+        printf(stdout, "mmap: shared write lost\n");
+        exit();
+    }
+    close(fd);
+
+    // write() shows in a shared mapping of the page, and munmap
+    // does not put the old data back
+    fd = open("mmapfile", O_RDWR);
+    p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED || p[0] != 'a' || write(fd, "xyz", 3) != 3 || p[0] != 'x'){
+        printf(stdout, "mmap: write not seen by shared mapping\n");
+        exit();
+    }
+    p[100] = 'Z';
+    if(munmap(p, 4096) < 0){
+        printf(stdout, "mmap: munmap failed\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("mmapfile", O_RDONLY);
+    if(read(fd, buf, 5000) != 5000 || buf[0] != 'x' || buf[2] != 'z' || buf[100] != 'Z'){
+        printf(stdout, "mmap: munmap wrote back stale data\n");
+        exit();
+    }
+    close(fd);
+    unlink("mmapfile");
+
+    // anonymous memory is zero, and copied on fork
+    p = mmap(0, 3 * 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    q = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED || q == MAP_FAILED || p[8191] != 0){
+        printf(stdout, "mmap: anonymous mapping failed\n");
+        exit();
+    }
+    p[0] = 'p';
+    pid = fork();
+    if(pid == 0){
+        if(p[0] != 'p')
+            printf(stdout, "mmap: child lost the mapping\n");
+        p[0] = 'c';
+        q[0] = 'c';
+        exit();
+    }
+    wait();
+    if(p[0] != 'p' || q[0] != 'c'){
+        printf(stdout, "mmap: fork shared the wrong pages\n");
+        exit();
+    }
+
+    // punch a hole; the rest stays mapped
+    if(munmap(p + 4096, 4096) < 0 || p[0] != 'p' || munmap(p, 4096) < 0
+       || munmap(p + 8192, 4096) < 0 || munmap(q, 4096) < 0){
+        printf(stdout, "mmap: munmap failed\n");
+        exit();
+    }
+
+    printf(stdout, "mmap ok\n");
+}
+
+// shared memory segments are shared by name and by fd
+void
+shmtest(void)
+{
+    char *p, *q;
+    int fd, fd2;
+
+    printf(stdout, "shm test\n");
+
+    fd = shmopen("ushm", 8192);
+    p = mmap(0, 8192, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(fd < 0 || p == MAP_FAILED || p[4096] != 0){
+        printf(stdout, "shm: cannot map segment\n");
+        exit();
+    }
+    if(mmap(0, 8192, PROT_READ, MAP_PRIVATE, fd, 0) != MAP_FAILED || read(fd, buf, 1) != -1){
+        printf(stdout, "shm: private mapping or read allowed\n");
+        exit();
+    }
+
+    if(fork() == 0){
+        fd2 = shmopen("ushm", 0);
+        q = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd2, 4096);
+        if(fd2 < 0 || q == MAP_FAILED)
+            printf(stdout, "shm: cannot open segment by name\n");
+        else
+            q[0] = 'c';
+        exit();
+    }
+    wait();
+
+    if(p[4096] != 'c'){
+        printf(stdout, "shm: write not shared\n");
+        exit();
+    }
+    munmap(p, 8192);
+    close(fd);
+
+    if(shmopen("ushm", 0) >= 0){
+        printf(stdout, "shm: segment outlived its files\n");
+        exit();
+    }
+
+    printf(stdout, "shm ok\n");
+}
+
+// spawn runs a program in a new process, with its output redirected
+void
+spawntest(void)
+{
+    int fd, fdmap[3], pid;
+    char *argv[] = { "echo", "spawned", 0 };
+
+    printf(stdout, "spawn test\n");
+
+    fd = open("spawnout", O_CREATE | O_RDWR);
+    fdmap[0] = 0;
+    fdmap[1] = fd;
+    fdmap[2] = 2;
+    if(fd < 0 || (pid = spawn("echo", argv, fdmap)) < 0 || wait() != pid){
+        printf(stdout, "spawn: spawn echo failed\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("spawnout", O_RDONLY);
+    if(read(fd, buf, sizeof(buf)) != 8 || buf[0] != 's' || buf[7] != '\n'){
+        printf(stdout, "spawn: wrong output\n");
+        exit();
+    }
+    close(fd);
+    unlink("spawnout");
+
+    if(spawn("nosuchprogram", argv, 0) >= 0){
+        printf(stdout, "spawn: spawned a missing program\n");
+        exit();
+    }
+
+    printf(stdout, "spawn ok\n");
+}
+
+// a vfork child runs first, on the parent's memory
+void
+vforktest(void)
+{
+    static volatile int shared;
+    int pid;
+
+    printf(stdout, "vfork test\n");
+
+    shared = 0;
+    pid = vfork();
+    if(pid == 0){
+        shared = 1;
+        exit();
+    }
+    if(pid < 0 || shared != 1 || wait() != pid){
+        printf(stdout, "vfork: parent did not wait for the child\n");
+        exit();
+    }
+
+    // a failed exec leaves the child on the parent's memory
+    pid = vfork();
+    if(pid == 0){
+        exec("nosuchprogram", echoargv);
+        shared = 2;
+        exit();
+    }
+    if(pid < 0 || shared != 2 || wait() != pid){
+        printf(stdout, "vfork: failed exec\n");
+        exit();
+    }
+
+    printf(stdout, "vfork ok\n");
+}
+
+// readv/writev gather and scatter; pread/pwrite leave the offset alone
+void
+iovtest(void)
+{
+    struct iovec iov[2];
+    char hdr[4], body[16];
+    int fd, fds[2], i;
+
+    printf(stdout, "iov test\n");
+
+    fd = open("iovfile", O_CREATE | O_RDWR);
+    if(fd < 0){
+        printf(stdout, "iov: create failed\n");
+        exit();
+    }
+
+    memmove(hdr, "HDR:", 4);
+    memmove(body, "payload!", 8);
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = 4;
+    iov[1].iov_base = body;
+    iov[1].iov_len = 8;
+    if(writev(fd, iov, 2) != 12 || writev(fd, iov, 0) >= 0){
+        printf(stdout, "iov: writev failed\n");
+        exit();
+    }
+
+    // patch the header in place, then append after it
+    if(pwrite(fd, "hdr", 3, 0) != 3 || write(fd, "+", 1) != 1){
+        printf(stdout, "iov: pwrite failed\n");
+        exit();
+    }
+
+    if(pread(fd, buf, 13, 0) != 13 || buf[0] != 'h' || buf[3] != ':'
+       || buf[4] != 'p' || buf[12] != '+' || pread(fd, buf, 1, 13) != 0){
+        printf(stdout, "iov: pread wrong data\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("iovfile", O_RDONLY);
+    iov[1].iov_len = 20;
+    if(readv(fd, iov, 2) != 13 || hdr[0] != 'h' || body[0] != 'p' || body[8] != '+'){
+        printf(stdout, "iov: readv failed\n");
+        exit();
+    }
+    close(fd);
+    unlink("iovfile");
+
+    // a pipe has no offset; readv does not wait to fill every buffer
+    if(pipe(fds) != 0){
+        printf(stdout, "iov: pipe failed\n");
+        exit();
+    }
+    iov[0].iov_len = 4;
+    iov[1].iov_len = 8;
+    if(writev(fds[1], iov, 2) != 12 || pwrite(fds[1], "x", 1, 0) >= 0){
+        printf(stdout, "iov: pipe writev failed\n");
+        exit();
+    }
+    iov[1].iov_base = buf;
+    iov[1].iov_len = 100;
+    if((i = readv(fds[0], iov, 2)) != 12 || buf[7] != '!'){
+        printf(stdout, "iov: pipe readv returned %d\n", i);
+        exit();
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    printf(stdout, "iov ok\n");
+}
+
+// splice moves data file -> pipe -> file inside the kernel
+void
+splicetest(void)
+{
+    int fd, fds[2], i, n;
+
+    printf(stdout, "splice test\n");
+
+    fd = open("splicein", O_CREATE | O_RDWR);
+    for(i = 0; i < 400; i++)
+        buf[i] = 'a' + i % 26;
+    if(fd < 0 || write(fd, buf, 400) != 400){
+        printf(stdout, "splice: create failed\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("splicein", O_RDONLY);
+    if(pipe(fds) != 0 || (n = splice(fd, fds[1], 1000)) != 400 || splice(fd, fds[1], 1000) != 0){
+        printf(stdout, "splice: file to pipe moved %d\n", n);
+        exit();
+    }
+    close(fd);
+    close(fds[1]);
+
+    fd = open("spliceout", O_CREATE | O_RDWR);
+    n = 0;
+    while((i = splice(fds[0], fd, 100)) > 0)
+        n += i;
+    close(fds[0]);
+    close(fd);
+    if(n != 400){
+        printf(stdout, "splice: pipe to file moved %d\n", n);
+        exit();
+    }
+
+    fd = open("spliceout", O_RDONLY);
+    if(read(fd, buf, sizeof(buf)) != 400 || buf[0] != 'a' || buf[399] != 'a' + 399 % 26){
+        printf(stdout, "splice: wrong data\n");
+        exit();
+    }
+    close(fd);
+
+    // a closed descriptor cannot be spliced
+    if(splice(fd, 1, 10) >= 0){
+        printf(stdout, "splice: spliced a closed fd\n");
+        exit();
+    }
+
+    unlink("splicein");
+    unlink("spliceout");
+    printf(stdout, "splice ok\n");
+}
+
+// a batch of operations through one ring_enter
+void
+ioringtest(void)
+{
+    static uint mem[IORING_SZ(8) / sizeof(uint)];
+    static int want[] = { 4, 4, 3, 0, -1 };
+    struct ioring *r;
+    struct iocqe c;
+    int fds[2], fd, i;
+
+    printf(stdout, "ioring test\n");
+
+    r = ioring_init(mem, 8);
+    ioring_prep(r, IO_OPEN, 0, "ioringfile", O_CREATE | O_RDWR, 0, 1);
+    if(ring_enter(r, 0) != 1 || !ioring_reap(r, &c) || c.data != 1 || (fd = c.res) < 0){
+        printf(stdout, "ioring: open failed\n");
+        exit();
+    }
+
+    ioring_prep(r, IO_WRITE, fd, "abcd", 4, -1, 2);
+    ioring_prep(r, IO_WRITE, fd, "efgh", 4, -1, 3);
+    ioring_prep(r, IO_READ, fd, buf, 3, 1, 4);
+    ioring_prep(r, IO_CLOSE, fd, 0, 0, 0, 5);
+    ioring_prep(r, IO_CLOSE, fd, 0, 0, 0, 6);
+    if(ring_enter(r, 0) != 5){
+        printf(stdout, "ioring: batch failed\n");
+        exit();
+    }
+    for(i = 2; i <= 6; i++){
+        if(!ioring_reap(r, &c) || c.data != i){
+            printf(stdout, "ioring: completion %d missing\n", i);
+            exit();
+        }
+        if(c.res != want[i - 2]){
+            printf(stdout, "ioring: completion %d returned %d\n", i, c.res);
+            exit();
+        }
+    }
+    if(buf[0] != 'b' || buf[2] != 'd' || ioring_reap(r, &c)){
+        printf(stdout, "ioring: wrong data\n");
+        exit();
+    }
+    unlink("ioringfile");
+
+    // an empty pipe stops the batch instead of waiting
+    if(pipe(fds) != 0){
+        printf(stdout, "ioring: pipe failed\n");
+        exit();
+    }
+    ioring_prep(r, IO_READ, fds[0], buf, 10, -1, 7);
+    if(ring_enter(r, IORING_NOWAIT) != 0 || ioring_reap(r, &c)){
+        printf(stdout, "ioring: waited on an empty pipe\n");
+        exit();
+    }
+    write(fds[1], "xyz", 3);
+    if(ring_enter(r, IORING_NOWAIT) != 1 || !ioring_reap(r, &c) || c.data != 7 || c.res != 3){
+        printf(stdout, "ioring: pipe read failed\n");
+        exit();
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    printf(stdout, "ioring ok\n");
+}
+
+// one process waits on several pipes at once
+void
+polltest(void)
+{
+    struct pollfd pfd[2];
+    int a[2], b[2], pid;
+
+    printf(stdout, "poll test\n");
+
+    if(pipe2(a, O_NONBLOCK) != 0 || pipe(b) != 0){
+        printf(stdout, "poll: pipe failed\n");
+        exit();
+    }
+
+    // nothing to read: a non-blocking read fails, poll times out
+    pfd[0].fd = a[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = b[0];
+    pfd[1].events = POLLIN;
+    if(read(a[0], buf, 1) != -1 || poll(pfd, 2, 0) != 0 || poll(pfd, 2, 2) != 0){
+        printf(stdout, "poll: ready with nothing written\n");
+        exit();
+    }
+
+    pid = fork();
+    if(pid == 0){
+        sleep(2);
+        write(b[1], "b", 1);
+        exit();
+    }
+    if(poll(pfd, 2, -1) != 1 || pfd[0].revents != 0 || pfd[1].revents != POLLIN){
+        printf(stdout, "poll: wrong pipe ready\n");
+        exit();
+    }
+    wait();
+
+    // a non-blocking write fills the pipe and then fails
+    while(write(a[1], buf, sizeof(buf)) > 0)
+        ;
+    pfd[0].fd = a[1];
+    pfd[0].events = POLLOUT;
+    if(poll(pfd, 1, 0) != 0){
+        printf(stdout, "poll: full pipe writable\n");
+        exit();
+    }
+
+    close(b[1]);
+    if(poll(&pfd[1], 1, 0) != 1 || !(pfd[1].revents & POLLHUP)){
+        printf(stdout, "poll: no hangup\n");
+        exit();
+    }
+
+    close(a[0]);
+    close(a[1]);
+    close(b[0]);
+    printf(stdout, "poll ok\n");
+}
+
+struct mutex tmutex;
+struct cond tcond;
+int tcount, tfd;
+
+void
+threadcount(void *arg)
+{
+    int i;
+
+    for(i = 0; i < 1000; i++){
+        mutex_lock(&tmutex);
+        tcount++;
+        mutex_unlock(&tmutex);
+        if(i % 100 == 0)
+            sleep(0);
+    }
+
+    mutex_lock(&tmutex);
+    cond_broadcast(&tcond);
+    mutex_unlock(&tmutex);
+}
+
+void
+threadopen(void *arg)
+{
+    tfd = open("threadfile", O_CREATE | O_RDWR);
+}
+
+// threads share memory and open files
+void
+threadtest(void)
+{
+    struct thread t[4];
+    int i;
+
+    printf(stdout, "thread test\n");
+
+    mutex_init(&tmutex);
+    cond_init(&tcond);
+    tcount = 0;
+    for(i = 0; i < 4; i++){
+        if(thread_create(&t[i], threadcount, 0) < 0){
+            printf(stdout, "thread: create failed\n");
+            exit();
+        }
+    }
+
+    // wait for the count on the condition variable, then join
+    mutex_lock(&tmutex);
+    while(tcount < 4000)
+        cond_wait(&tcond, &tmutex);
+    mutex_unlock(&tmutex);
+
+    for(i = 0; i < 4; i++)
+        thread_join(&t[i]);
+    if(tcount != 4000 || t[0].tid != 0){
+        printf(stdout, "thread: count %d\n", tcount);
+        exit();
+    }
+
+    tfd = -1;
+    if(thread_create(&t[0], threadopen, 0) < 0 || thread_join(&t[0]) < 0
+       || tfd < 0 || write(tfd, "x", 1) != 1){
+        printf(stdout, "thread: file not shared\n");
+        exit();
+    }
+    close(tfd);
+    unlink("threadfile");
+
+    // threads are not children to wait for
+    if(wait() != -1){
+        printf(stdout, "thread: wait found a thread\n");
+        exit();
+    }
+
+    printf(stdout, "thread ok\n");
+}
+
+struct chan *cochan;
+int cosum;
+
+void
+cosend(void *arg)
+{
+    int i;
+
+    for(i = 1; i <= 100; i++)
+        chan_send(cochan, i);
+    chan_close(cochan);
+}
+
+void
+corecv(void *arg)
+{
+    int v;
+
+    while(chan_recv(cochan, &v)){
+        cosum += v;
+        co_yield();
+    }
+}
+
+// coroutines pass values over unbuffered and buffered channels
+void
+cotest(void)
+{
+    int cap;
+
+    printf(stdout, "coroutine test\n");
+
+    for(cap = 0; cap <= 8; cap += 8){
+        cochan = chan_new(cap);
+        cosum = 0;
+        if(cochan == 0 || co_spawn(corecv, 0) < 0 || co_spawn(cosend, 0) < 0){
+            printf(stdout, "coroutine: spawn failed\n");
+            exit();
+        }
+        co_run();
+        if(cosum != 5050){
+            printf(stdout, "coroutine: sum %d over chan %d\n", cosum, cap);
+            exit();
+        }
+        if(chan_send(cochan, 1) != -1){
+            printf(stdout, "coroutine: send on closed chan\n");
+            exit();
+        }
+        chan_free(cochan);
+    }
+
+    printf(stdout, "coroutine ok\n");
+}
+
+// readdirplus returns each entry once, with its type and size
+void
+readdirtest(void)
+{
+    struct direntplus de[3];
+    struct stat st;
+    char path[8];
+    int fd, i, n, seen;
+
+    printf(stdout, "readdirplus test\n");
+
+    if(mkdir("rdir") < 0){
+        printf(stdout, "readdirplus: mkdir failed\n");
+        exit();
+    }
+    strcpy(path, "rdir/f0");
+    for(i = 0; i < 10; i++){
+        path[6] = '0' + i;
+        fd = open(path, O_CREATE | O_RDWR);
+        write(fd, buf, i);
+        close(fd);
+    }
+
+    fd = open("rdir", O_RDONLY);
+    seen = 0;
+    while((n = readdirplus(fd, de, 3)) > 0){
+        for(i = 0; i < n; i++){
+            if(de[i].name[0] == '.'){
+                if(de[i].type != T_DIR){
+                    printf(stdout, "readdirplus: %s not a directory\n", de[i].name);
+                    exit();
+                }
+                continue;
+            }
+            path[6] = de[i].name[1];
+            if(stat(path, &st) < 0 || de[i].type != T_FILE || de[i].inum != st.ino
+               || de[i].size != de[i].name[1] - '0'){
+                printf(stdout, "readdirplus: bad entry %s\n", de[i].name);
+                exit();
+            }
+            seen |= 1 << (de[i].name[1] - '0');
+        }
+    }
+    close(fd);
+    if(n < 0 || seen != 0x3ff){
+        printf(stdout, "readdirplus: saw %x\n", seen);
+        exit();
+    }
+
+    fd = open(path, O_RDONLY);
+    if(readdirplus(fd, de, 3) != -1){
+        printf(stdout, "readdirplus: read a file\n");
+        exit();
+    }
+    close(fd);
+
+    for(i = 0; i < 10; i++){
+        path[6] = '0' + i;
+        unlink(path);
+    }
+    unlink("rdir");
+
+    printf(stdout, "readdirplus ok\n");
+}
+
+// a directory that outgrows a block is hashed; its entries can
+// still be found, listed and removed
+void
+hashdirtest(void)
+{
+    struct direntplus de[8];
+    char path[8];
+    int fd, i, n, seen;
+
+    printf(stdout, "hashed directory test\n");
+
+    if(mkdir("hd") < 0){
+        printf(stdout, "hashdir: mkdir failed\n");
+        exit();
+    }
+    strcpy(path, "hd/h00");
+    for(i = 0; i < 100; i++){
+        path[4] = '0' + i / 10;
+        path[5] = '0' + i % 10;
+        if((fd = open(path, O_CREATE | O_RDWR)) < 0){
+            printf(stdout, "hashdir: create %s failed\n", path);
+            exit();
+        }
+        close(fd);
+    }
+    for(i = 0; i < 100; i++){
+        path[4] = '0' + i / 10;
+        path[5] = '0' + i % 10;
+        if((fd = open(path, O_RDONLY)) < 0){
+            printf(stdout, "hashdir: open %s failed\n", path);
+            exit();
+        }
+        close(fd);
+    }
+
+    fd = open("hd", O_RDONLY);
+    seen = 0;
+    while((n = readdirplus(fd, de, 8)) > 0)
+        seen += n;
+    close(fd);
+    if(seen != 102){
+        printf(stdout, "hashdir: listed %d entries\n", seen);
+        exit();
+    }
+
+    if(unlink("hd") == 0){
+        printf(stdout, "hashdir: removed a full directory\n");
+        exit();
+    }
+    for(i = 0; i < 100; i++){
+        path[4] = '0' + i / 10;
+        path[5] = '0' + i % 10;
+        if(unlink(path) < 0){
+            printf(stdout, "hashdir: unlink %s failed\n", path);
+            exit();
+        }
+    }
+    if(chdir("hd") < 0 || chdir("..") < 0 || unlink("hd") < 0){
+        printf(stdout, "hashdir: cannot remove the emptied directory\n");
+        exit();
+    }
+
+    printf(stdout, "hashed directory ok\n");
+}
+
+// a small file's data lives in its inode until it grows out of it
+void
+inlinetest(void)
+{
+    char data[200], back[200];
+    int fd, i, n;
+
+    printf(stdout, "inline data test\n");
+
+    for(i = 0; i < sizeof(data); i++)
+        data[i] = 'a' + i % 26;
+
+    // grow a byte, then a few, then past the inode, then a lot
+    unlink("inlinef");
+    fd = open("inlinef", O_CREATE | O_RDWR);
+    if(fd < 0 || write(fd, data, 1) != 1 || write(fd, data+1, 40) != 40
+       || write(fd, data+41, 11) != 11 || write(fd, data+52, 1) != 1
+       || write(fd, data+53, 147) != 147){
+        printf(stdout, "inline: write failed\n");
+        exit();
+    }
+    close(fd);
+
+    fd = open("inlinef", O_RDONLY);
+    n = read(fd, back, sizeof(back));
+    close(fd);
+    for(i = 0; i < n && back[i] == data[i]; i++)
+        ;
+    if(n != sizeof(data) || i != n){
+        printf(stdout, "inline: read back %d bytes wrong\n", n);
+        exit();
+    }
+
+    // rewrite in place without growing
+    fd = open("inlinef2", O_CREATE | O_RDWR);
+    write(fd, data, 30);
+    close(fd);
+    fd = open("inlinef2", O_RDWR);
+    write(fd, "XY", 2);
+    close(fd);
+    fd = open("inlinef2", O_RDONLY);
+    n = read(fd, back, sizeof(back));
+    close(fd);
+    for(i = 2; i < n && back[i] == data[i]; i++)
+        ;
+    if(n != 30 || back[0] != 'X' || back[1] != 'Y' || i != n){
+        printf(stdout, "inline: rewrite failed\n");
+        exit();
+    }
+
+    unlink("inlinef");
+    unlink("inlinef2");
+    printf(stdout, "inline data ok\n");
+}
+
 // does unintialized data start out zero?
 char uninit[10000];
 void
@@ -1613,10 +2503,25 @@ main(int argc, char *argv[])
     bsstest();
     sbrktest();
     validatetest();
+    copyfault();
+    pagecache();
+    mmaptest();
+    shmtest();
+    spawntest();
+    vforktest();
     
     opentest();
     writetest();
     writetest1();
+    iovtest();
+    splicetest();
+    ioringtest();
+    polltest();
+    threadtest();
+    cotest();
+    readdirtest();
+    hashdirtest();
+    inlinetest();
     createtest();
     
     mem();
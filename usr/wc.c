@@ -1,35 +1,86 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "stdio.h"
 
-char buf[512];
+// wc looks at a word (4 bytes) at a time: it finds the newlines and
+// whitespace in a word with a few arithmetic operations on the whole
+// word (SWAR), without a branch or a load per byte. The bytes left
+// over at the end of a read go through a lookup table.
+
+#define ONES    0x01010101
+#define HIGHS   0x80808080
+
+// Whitespace, as wc counts it.
+uchar space[256] = {
+    ['\t'] = 1, ['\n'] = 1, ['\v'] = 1, ['\r'] = 1, [' '] = 1,
+};
+
+uint wbuf[8192];                // 32 KB, word aligned
+
+// 0x80 in each byte of x that is c.
+static inline uint
+eqbytes(uint x, uint c)
+{
+    uint t;
+
+    t = x ^ (c * ONES);
+    return ~(((t & ~HIGHS) + ~HIGHS) | t) & HIGHS;
+}
+
+// 0x80 in each byte of x that is whitespace: a space, or 9 to 13
+// but not 12 ('\f').
+static inline uint
+spaces(uint x)
+{
+    uint low, ctl;
+
+    low = x & ~HIGHS;
+    ctl = (low + 0x77777777) & ~(low + 0x72727272) & ~x & HIGHS;
+    return eqbytes(x, ' ') | (ctl & ~eqbytes(x, '\f'));
+}
+
+// The number of bytes with 0x80 set in m, where no others are set.
+static inline int
+count(uint m)
+{
+    return ((m >> 7) * ONES) >> 24;
+}
 
 void
 wc(int fd, char *name)
 {
+    char *buf;
+    uint x, s, prev;
     int i, n;
-    int l, w, c, inword;
+    int l, w, c;
     
+    buf = (char*)wbuf;
     l = w = c = 0;
-    inword = 0;
-    while((n = read(fd, buf, sizeof(buf))) > 0){
-        for(i=0; i<n; i++){
-            c++;
-            if(buf[i] == '\n')
-                l++;
-            if(strchr(" \r\t\n\v", buf[i]))
-                inword = 0;
-            else if(!inword){
-                w++;
-                inword = 1;
-            }
+    prev = 1;                   // the byte before is whitespace
+    while((n = read(fd, buf, sizeof(wbuf))) > 0){
+        c += n;
+        for(i = 0; i+4 <= n; i += 4){
+            x = wbuf[i/4];
+            s = spaces(x);
+            l += count(eqbytes(x, '\n'));
+            // a word starts at a byte that is not whitespace after one that is
+            w += count(~s & ((s << 8) | (prev << 7)) & HIGHS);
+            prev = s >> 31;
+        }
+        for(; i < n; i++){
+            s = space[(uchar)buf[i]];
+            l += buf[i] == '\n';
+            w += prev & !s;
+            prev = s;
         }
     }
     if(n < 0){
-        printf(1, "wc: read error\n");
+        fprintf(stdout, "wc: read error\n");
+        fflush(stdout);
         exit();
     }
-    printf(1, "%d %d %d %s\n", l, w, c, name);
+    fprintf(stdout, "%d %d %d %s\n", l, w, c, name);
 }
 
 int
@@ -39,16 +90,19 @@ main(int argc, char *argv[])
     
     if(argc <= 1){
         wc(0, "");
+        fflush(stdout);
         exit();
     }
     
     for(i = 1; i < argc; i++){
         if((fd = open(argv[i], 0)) < 0){
-            printf(1, "wc: cannot open %s\n", argv[i]);
+            fprintf(stdout, "wc: cannot open %s\n", argv[i]);
+            fflush(stdout);
             exit();
         }
         wc(fd, argv[i]);
         close(fd);
     }
+    fflush(stdout);
     exit();
 }
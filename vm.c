@@ -63,10 +63,15 @@ void kpt_freerange (uint32 low, uint32 hi)
     }
 }
 
+// Allocate a zeroed page table, preferably one zeroed by the idle loop.
 void* kpt_alloc (void)
 {
     struct run *r;
-    
+
+    if ((r = kmalloc_prezeroed(PT_ORDER)) != NULL) {
+        return (char*) r;
+    }
+
     acquire(&kpt_mem.lock);
     
     if ((r = kpt_mem.freelist) != NULL ) {
@@ -75,18 +80,22 @@ void* kpt_alloc (void)
 
     release(&kpt_mem.lock);
 
+    if (r != NULL) {
+        memset(r, 0, PT_SZ);
+        return (char*) r;
+    }
+
     // Allocate a PT page if no inital pages is available
-    if ((r == NULL) && ((r = kmalloc (PT_ORDER)) == NULL)) {
+    if ((r = kmalloc_zero (PT_ORDER)) == NULL) {
         panic("oom: kpt_alloc");
     }
 
-    memset(r, 0, PT_SZ);
     return (char*) r;
 }
 
 // Return the address of the PTE in page directory that corresponds to
 // virtual address va.  If alloc!=0, create any required page table pages.
-static pte_t* walkpgdir (pde_t *pgdir, const void *va, int alloc)
+pte_t* walkpgdir (pde_t *pgdir, const void *va, int alloc)
 {
     pde_t *pde;
     pte_t *pgtab;
@@ -98,13 +107,11 @@ static pte_t* walkpgdir (pde_t *pgdir, const void *va, int alloc)
         pgtab = (pte_t*) p2v(PT_ADDR(*pde));
 
     } else {
+        // kpt_alloc returns it zeroed: no PTE is present
         if (!alloc || (pgtab = (pte_t*) kpt_alloc()) == 0) {
             return 0;
         }
 
-        // Make sure all those PTE_P bits are zero.
-        memset(pgtab, 0, PT_SZ);
-
         // The permissions here are overly generous, but they can
         // be further restricted by the permissions in the page table
         // entries, if necessary.
@@ -117,7 +124,7 @@ static pte_t* walkpgdir (pde_t *pgdir, const void *va, int alloc)
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
-static int mappages (pde_t *pgdir, void *va, uint size, uint pa, int ap)
+int mappages (pde_t *pgdir, void *va, uint size, uint pa, int ap)
 {
     char *a, *last;
     pte_t *pte;
@@ -186,12 +193,45 @@ void inituvm (pde_t *pgdir, char *init, uint sz)
         panic("inituvm: more than a page");
     }
 
-    mem = alloc_page();
-    memset(mem, 0, PTE_SZ);
+    mem = alloc_zpage();
     mappages(pgdir, 0, PTE_SZ, v2p(mem), AP_KU);
     memmove(mem, init, sz);
 }
 
+// Map the pages of a read-only program segment from the page cache
+// into pgdir instead of copying them, so all processes running the
+// program share one copy. addr and offset must be page-aligned and
+// nothing may be mapped from addr to addr+sz yet. The pages are
+// read-only to the user.
+int shareuvm (pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
+{
+    struct cpage *cp;
+    char *mem;
+    uint i;
+
+    if ((uint) addr % PTE_SZ != 0 || offset % PTE_SZ != 0) {
+        panic("shareuvm: addr must be page aligned");
+    }
+
+    if ((uint) addr + sz >= UADDR_SZ) {
+        return -1;
+    }
+
+    for (i = 0; i < sz; i += PTE_SZ) {
+        if ((cp = pcache_get(ip, (offset + i) / PTE_SZ)) == 0) {
+            return -1;
+        }
+
+        mem = pcache_data(cp);
+        page_dup(mem);
+        pcache_put(cp);
+
+        mappages(pgdir, addr + i, PTE_SZ, v2p(mem), AP_KUR);
+    }
+
+    return 0;
+}
+
 // Load a program segment into pgdir.  addr must be page-aligned
 // and the pages from addr to addr+sz must already be mapped.
 int loaduvm (pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
@@ -242,15 +282,13 @@ int allocuvm (pde_t *pgdir, uint oldsz, uint newsz)
     a = align_up(oldsz, PTE_SZ);
 
     for (; a < newsz; a += PTE_SZ) {
-        mem = alloc_page();
+        mem = alloc_zpage();
 
         if (mem == 0) {
             cprintf("allocuvm out of memory\n");
             deallocuvm(pgdir, newsz, oldsz);
             return 0;
         }
-
-        memset(mem, 0, PTE_SZ);
         mappages(pgdir, (char*) a, PTE_SZ, v2p(mem), AP_KU);
     }
 
@@ -349,7 +387,8 @@ pde_t* copyuvm (pde_t *pgdir, uint sz)
         return NULL ;
     }
 
-    // copy the whole address space over (no COW)
+    // copy the whole address space over (no COW), except for the
+    // read-only pages, which are shared
     for (i = 0; i < sz; i += PTE_SZ) {
         if ((pte = walkpgdir(pgdir, (void *) i, 0)) == 0) {
             panic("copyuvm: pte should exist");
@@ -362,12 +401,17 @@ pde_t* copyuvm (pde_t *pgdir, uint sz)
         pa = PTE_ADDR (*pte);
         ap = PTE_AP (*pte);
 
-        if ((mem = alloc_page()) == 0) {
+        if (ap == AP_KUR) {
+            mem = p2v(pa);
+            page_dup(mem);
+
+        } else if ((mem = alloc_page()) != 0) {
+            memmove(mem, (char*) p2v(pa), PTE_SZ);
+
+        } else {
             goto bad;
         }
 
-        memmove(mem, (char*) p2v(pa), PTE_SZ);
-
         if (mappages(d, (void*) i, PTE_SZ, v2p(mem), ap) < 0) {
             goto bad;
         }
@@ -379,69 +423,187 @@ bad: freevm(d);
 }
 
 //PAGEBREAK!
-// Map user virtual address to kernel address.
-char* uva2ka (pde_t *pgdir, char *uva)
+// A walk over the user pages of pgdir. It remembers the page table
+// of the last lookup, so a span of pages looks at the page directory
+// once per 1MB instead of once per page.
+struct uwalk {
+    pde_t *pgdir;
+    uint  pdx;      // index of pgtab in pgdir
+    pte_t *pgtab;   // 0 until the first lookup
+};
+
+// Return the kernel address for user address va, or 0 if its page is
+// not present or not accessible to the user (for writing if write).
+static char* uwalk_addr (struct uwalk *w, uint va, int write)
 {
-    pte_t *pte;
+    pte_t pte;
+    uint ap;
 
-    pte = walkpgdir(pgdir, uva, 0);
+    if (va >= UADDR_SZ) {
+        return 0;
+    }
 
-    // make sure it exists
-    if ((*pte & PE_TYPES) == 0) {
+    if ((w->pgtab == 0) || (w->pdx != PDE_IDX(va))) {
+        if (!(w->pgdir[PDE_IDX(va)] & PE_TYPES)) {
+            return 0;
+        }
+
+        w->pdx = PDE_IDX(va);
+        w->pgtab = (pte_t*) p2v(PT_ADDR(w->pgdir[w->pdx]));
+    }
+
+    pte = w->pgtab[PTE_IDX(va)];
+
+    if ((pte & PE_TYPES) == 0) {
         return 0;
     }
 
-    // make sure it is a user page
-    if (PTE_AP(*pte) != AP_KU) {
+    ap = PTE_AP(pte);
+
+    if ((ap != AP_KU) && (write || (ap != AP_KUR))) {
         return 0;
     }
 
-    return (char*) p2v(PTE_ADDR(*pte));
+    return (char*) p2v(PTE_ADDR(pte)) + (va & (PTE_SZ - 1));
+}
+
+// Return the kernel address for va and, in *n, how many of the len
+// bytes from there are contiguous in kernel memory too (neighbouring
+// pages often are), so they can be copied in one go.
+static char* uwalk_span (struct uwalk *w, uint va, uint len, int write, uint *n)
+{
+    char *ka;
+
+    if ((ka = uwalk_addr(w, va, write)) == 0) {
+        return 0;
+    }
+
+    *n = PTE_SZ - (va & (PTE_SZ - 1));
+
+    while ((*n < len) && (uwalk_addr(w, va + *n, write) == ka + *n)) {
+        *n += PTE_SZ;
+    }
+
+    if (*n > len) {
+        *n = len;
+    }
+
+    return ka;
+}
+
+// Return the kernel address for user address va in pgdir, or 0 if
+// its page is not present.
+char* uva2ka (pde_t *pgdir, uint va)
+{
+    struct uwalk w;
+
+    w.pgdir = pgdir;
+    w.pgtab = 0;
+
+    return uwalk_addr(&w, va, 0);
 }
 
 // Copy len bytes from p to user address va in page table pgdir.
 // Most useful when pgdir is not the current page table.
-// uva2ka ensures this only works for user pages.
+// Only works for pages the user may write.
 int copyout (pde_t *pgdir, uint va, void *p, uint len)
 {
-    char *buf, *pa0;
-    uint n, va0;
+    struct uwalk w;
+    char *buf, *ka;
+    uint n;
 
+    w.pgdir = pgdir;
+    w.pgtab = 0;
     buf = (char*) p;
 
     while (len > 0) {
-        va0 = align_dn(va, PTE_SZ);
-        pa0 = uva2ka(pgdir, (char*) va0);
-
-        if (pa0 == 0) {
+        if ((ka = uwalk_span(&w, va, len, 1, &n)) == 0) {
             return -1;
         }
 
-        n = PTE_SZ - (va - va0);
+        memmove(ka, buf, n);
+
+        len -= n;
+        buf += n;
+        va += n;
+    }
+
+    return 0;
+}
+
+// Copy len bytes from user address va in page table pgdir to dst.
+int copyin (pde_t *pgdir, void *dst, uint va, uint len)
+{
+    struct uwalk w;
+    char *buf, *ka;
+    uint n;
+
+    w.pgdir = pgdir;
+    w.pgtab = 0;
+    buf = (char*) dst;
 
-        if (n > len) {
-            n = len;
+    while (len > 0) {
+        if ((ka = uwalk_span(&w, va, len, 0, &n)) == 0) {
+            return -1;
         }
 
-        memmove(pa0 + (va - va0), buf, n);
+        memmove(buf, ka, n);
 
         len -= n;
         buf += n;
-        va = va0 + PTE_SZ;
+        va += n;
     }
 
     return 0;
 }
 
+// Copy the nul-terminated string at user address va to dst, which
+// has room for max bytes. Return the length of the string, not
+// including nul, or -1 if it faults or does not fit.
+int copyinstr (pde_t *pgdir, char *dst, uint va, uint max)
+{
+    struct uwalk w;
+    char *ka;
+    uint n, i, tot;
+
+    w.pgdir = pgdir;
+    w.pgtab = 0;
+
+    for (tot = 0; tot < max; tot += n, va += n) {
+        if ((ka = uwalk_span(&w, va, max - tot, 0, &n)) == 0) {
+            return -1;
+        }
+
+        for (i = 0; i < n; i++) {
+            if ((dst[tot + i] = ka[i]) == 0) {
+                return tot + i;
+            }
+        }
+    }
 
-// 1:1 map the memory [phy_low, phy_hi] in kernel. We need to
-// use 2-level mapping for this block of memory. The rumor has
-// it that ARMv6's small brain cannot handle the case that memory
-// be mapped in both 1-level page table and 2-level page. For
-// initial kernel, we use 1MB mapping, other memory needs to be
-// mapped as 4KB pages
-void paging_init (uint phy_low, uint phy_hi)
+    return -1;
+}
+
+// Copy to dst, which is a user address of the current process if it
+// is below UADDR_SZ and a kernel address otherwise. Lets readi and
+// the pipes serve both user buffers and kernel ones.
+int either_copyout (void *dst, void *src, uint len)
 {
-    mappages (P2V(&_kernel_pgtbl), P2V(phy_low), phy_hi - phy_low, phy_low, AP_KU);
-    flush_tlb ();
+    if ((uint) dst < UADDR_SZ) {
+        return copyout(proc->pgdir, (uint) dst, src, len);
+    }
+
+    memmove(dst, src, len);
+    return 0;
+}
+
+// Copy from src, a user or a kernel address as for either_copyout.
+int either_copyin (void *dst, void *src, uint len)
+{
+    if ((uint) src < UADDR_SZ) {
+        return copyin(proc->pgdir, dst, (uint) src, len);
+    }
+
+    memmove(dst, src, len);
+    return 0;
 }